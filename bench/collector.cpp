@@ -0,0 +1,97 @@
+#include <commlib/collector.h>
+#include <commlib/pack.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <algorithm>
+
+/* Message extraction from a Collector holding 64 KB read buffers, as Piper fills it:
+   byte by byte through std::back_inserter (the former getMessage<std::string>() path)
+   vs Collector::getMessage<std::string>() (resize once + memcpy, non-temporal for large messages)
+*/
+
+using namespace uvcomms4;
+
+namespace
+{
+    constexpr std::size_t read_size = 64 * 1024;
+    constexpr std::size_t bytes_per_size = 128 * 1024 * 1024; // how much to extract for every message size
+
+    std::vector<char> makeStream(std::size_t aMessageSize)
+    {
+        std::vector<char> stream(Collector::header_size + aMessageSize, 'x');
+        auto length = static_cast<std::uint32_t>(aMessageSize);
+        u32_pack(length, stream.data());
+        u32_pack(length_hash(length), stream.data() + 4);
+        return stream;
+    }
+
+    /// as many messages as fit in one read go in one buffer
+    void fill(Collector & aCollector, std::vector<char> const & aStream, std::size_t aCount)
+    {
+        std::size_t total = aStream.size() * aCount;
+        std::size_t offset = 0;
+        while(offset < total)
+        {
+            std::size_t size = std::min(read_size, total - offset);
+            char *block = ReadBuffer::memalloc(size);
+            for(std::size_t i = 0; i < size; )
+            {
+                std::size_t pos = (offset + i) % aStream.size();
+                std::size_t n = std::min(size - i, aStream.size() - pos);
+                std::memcpy(block + i, aStream.data() + pos, n);
+                i += n;
+            }
+            aCollector.append(ReadBuffer(block, size));
+            offset += size;
+        }
+    }
+
+    template<typename extract_t>
+    double mb_per_s(std::size_t aMessageSize, extract_t && aExtract)
+    {
+        auto stream = makeStream(aMessageSize);
+        std::size_t perRound = std::max<std::size_t>(1, std::min<std::size_t>(1024, 4 * read_size / aMessageSize));
+        std::size_t rounds = std::max<std::size_t>(3, bytes_per_size / (aMessageSize * perRound));
+
+        std::chrono::steady_clock::duration elapsed {};
+        std::size_t extracted = 0;
+        for(std::size_t r = 0; r < rounds; r++)
+        {
+            Collector collector;
+            fill(collector, stream, perRound);
+
+            auto start = std::chrono::steady_clock::now();
+            for(std::size_t m = 0; m < perRound; m++)
+                extracted += aExtract(collector);
+            elapsed += std::chrono::steady_clock::now() - start;
+        }
+
+        if(extracted != rounds * perRound * aMessageSize)
+            std::cerr << "ERROR: extracted " << extracted << " bytes\n";
+        return double(extracted) / std::chrono::duration<double, std::micro>(elapsed).count();
+    }
+}
+
+void bench_collector()
+{
+    std::cout << std::setw(10) << "size" << std::setw(16) << "back_inserter" << std::setw(16) << "getMessage" << "  (MB/s)\n";
+    for(std::size_t size = 16; size <= 64 * 1024 * 1024; size *= 4)
+    {
+        double perByte = mb_per_s(size, [](Collector & aCollector) {
+            std::string message;
+            message.reserve(aCollector.messageLength());
+            aCollector.extractMessageTo(std::back_inserter(message));
+            return message.size();
+        });
+        double bulk = mb_per_s(size, [](Collector & aCollector) {
+            auto [status, message] = aCollector.getMessage<std::string>();
+            return message.size();
+        });
+        std::cout << std::setw(10) << size << std::setw(16) << std::fixed << std::setprecision(0) << perByte
+            << std::setw(16) << bulk << std::endl;
+    }
+}
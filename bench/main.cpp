@@ -0,0 +1,40 @@
+#include <iostream>
+#include <string>
+#include <map>
+#include <functional>
+
+void bench_slotmap();
+void bench_collector();
+
+int main(int argc, char *argv[])
+{
+    std::map<std::string, std::function<void()>> benchmarks {
+        { "slotmap", bench_slotmap },
+        { "collector", bench_collector },
+    };
+
+    // run the named benchmarks or all of them
+    if(argc < 2)
+    {
+        for(auto & [name, fun]: benchmarks)
+        {
+            std::cout << "=== " << name << std::endl;
+            fun();
+        }
+        return 0;
+    }
+
+    for(int i = 1; i < argc; i++)
+    {
+        auto found = benchmarks.find(argv[i]);
+        if(found == benchmarks.end())
+        {
+            std::cerr << "Unknown benchmark: " << argv[i] << std::endl;
+            return 1;
+        }
+        std::cout << "=== " << found->first << std::endl;
+        found->second();
+    }
+
+    return 0;
+}
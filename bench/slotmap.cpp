@@ -0,0 +1,107 @@
+#include <commlib/slotmap.h>
+#include <commlib/commlib.h>
+#include <unordered_map>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+/* Descriptor -> pipe lookups as done by Piper::pipeGet() on every write request:
+   the former std::unordered_map<Descriptor, UVPipe*> vs SlotMap<UVPipe*>
+*/
+
+using namespace uvcomms4;
+
+namespace
+{
+    constexpr std::size_t live_pipes = 100'000;
+    constexpr std::size_t lookups = 10'000'000;
+    constexpr std::size_t churn_rounds = 1'000'000;
+
+    struct FakePipe { int dummy; };
+
+    template<typename fun_t>
+    double ns_per_op(std::size_t aCount, fun_t && aFun)
+    {
+        auto start = std::chrono::steady_clock::now();
+        aFun();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / aCount;
+    }
+
+    void report(char const *aWhat, double aMap, double aSlots)
+    {
+        std::cout << aWhat << ": unordered_map " << aMap << " ns/op, SlotMap " << aSlots << " ns/op\n";
+    }
+}
+
+void bench_slotmap()
+{
+    std::vector<FakePipe> pipes(live_pipes);
+    std::mt19937 rs{ 12345 };
+
+    std::unordered_map<Descriptor, FakePipe*> map;
+    std::vector<Descriptor> mapKeys;
+    Descriptor nextDescriptor = 1;
+
+    SlotMap<FakePipe*> slots;
+    std::vector<SlotMap<FakePipe*>::key_t> slotKeys;
+
+    for(auto & pipe: pipes)
+    {
+        mapKeys.push_back(nextDescriptor);
+        map.insert({ nextDescriptor++, &pipe });
+        slotKeys.push_back(slots.insert(&pipe));
+    }
+
+    // random access pattern, same for both
+    std::vector<std::size_t> order(lookups);
+    std::uniform_int_distribution<std::size_t> pick(0, live_pipes - 1);
+    std::generate(order.begin(), order.end(), [&]{ return pick(rs); });
+
+    std::size_t found = 0;
+    double mapLookup = ns_per_op(lookups, [&]{
+        for(std::size_t i: order)
+            found += map.find(mapKeys[i]) != map.end();
+    });
+    double slotLookup = ns_per_op(lookups, [&]{
+        for(std::size_t i: order)
+            found += slots.find(slotKeys[i]) != nullptr;
+    });
+    report("lookup", mapLookup, slotLookup);
+
+    // connection churn: close a random pipe and open a new one
+    double mapChurn = ns_per_op(churn_rounds, [&]{
+        for(std::size_t r = 0; r < churn_rounds; r++)
+        {
+            std::size_t i = order[r];
+            map.erase(mapKeys[i]);
+            mapKeys[i] = nextDescriptor;
+            map.insert({ nextDescriptor++, &pipes[i] });
+        }
+    });
+    double slotChurn = ns_per_op(churn_rounds, [&]{
+        for(std::size_t r = 0; r < churn_rounds; r++)
+        {
+            std::size_t i = order[r];
+            slots.erase(slotKeys[i]);
+            slotKeys[i] = slots.insert(&pipes[i]);
+        }
+    });
+    report("close + open", mapChurn, slotChurn);
+
+    // lookups again, after the churn
+    mapLookup = ns_per_op(lookups, [&]{
+        for(std::size_t i: order)
+            found += map.find(mapKeys[i]) != map.end();
+    });
+    slotLookup = ns_per_op(lookups, [&]{
+        for(std::size_t i: order)
+            found += slots.find(slotKeys[i]) != nullptr;
+    });
+    report("lookup after churn", mapLookup, slotLookup);
+
+    if(found != 4 * lookups)
+        std::cerr << "ERROR: some lookups failed\n";
+}
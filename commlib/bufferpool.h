@@ -0,0 +1,187 @@
+#pragma once
+
+#include "commlib.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace uvcomms4
+{
+    class BufferPool;
+
+    /** Precedes the data of every ReadBuffer block
+    */
+    struct alignas(std::max_align_t) BufferHeader
+    {
+        std::atomic<std::uint32_t>  refs { 1 };
+        bool                        mapped { false }; // see ReadBuffer::memmap()
+        BufferPool                 *pool { nullptr }; // null for blocks from the heap
+    };
+
+    struct BufferPoolStats
+    {
+        std::size_t hits { 0 };   // blocks served by the pool
+        std::size_t misses { 0 }; // blocks that had to come from the heap
+    };
+
+    /** Receive buffers for one IO thread: fixed-size slabs carved from page-aligned arenas
+     *  (2 MB each, so that they can be backed by a huge page), allocated on demand up to
+     *  a maximum number of slabs. Slabs are only taken on the owner's thread but may be
+     *  returned from any thread (a MessageView may outlive its read), so the free list is
+     *  a Treiber stack; with a single consumer it is not exposed to ABA.
+     *  The owner retires the pool rather than deleting it: the pool goes away once
+     *  the last of its slabs has been returned.
+    */
+    class BufferPool
+    {
+    public:
+        static constexpr std::size_t slab_size = 64 * 1024; // the largest receive buffer
+        static constexpr std::size_t arena_size = 2 * 1024 * 1024;
+
+        struct Retire
+        {
+            void operator () (BufferPool *aPool) const noexcept
+            {
+                aPool->retire();
+            }
+        };
+
+        using pointer = std::unique_ptr<BufferPool, Retire>;
+
+        /// aMaxSlabs limits the memory the pool may take
+        static pointer create(std::size_t aMaxSlabs, bool aHugePages)
+        {
+            return pointer(new BufferPool(aMaxSlabs, aHugePages));
+        }
+
+        BufferPool(BufferPool const &) = delete;
+        BufferPool & operator = (BufferPool const &) = delete;
+
+        /** A block of at least aSize bytes, preceded by an initialized BufferHeader;
+         *  nullptr if the pool cannot help. Owner's thread only
+        */
+        char *allocate(std::size_t aSize);
+
+        /// takes back a block whose last reference has been released; any thread
+        void release(char *aData) noexcept;
+
+        BufferPoolStats stats() const noexcept
+        {
+            return { mHits.load(std::memory_order_relaxed), mMisses.load(std::memory_order_relaxed) };
+        }
+
+    private:
+        static constexpr std::size_t stride = sizeof(BufferHeader) + slab_size;
+        static constexpr std::size_t slabs_per_arena = arena_size / stride;
+
+        struct FreeSlab // lives in the data area of a free slab
+        {
+            FreeSlab *next;
+        };
+
+        BufferPool(std::size_t aMaxSlabs, bool aHugePages) :
+            mMaxArenas((aMaxSlabs + slabs_per_arena - 1) / slabs_per_arena),
+            mHugePages(aHugePages)
+        {}
+
+        ~BufferPool()
+        {
+            for(void *arena: mArenas)
+                free_pages(arena, arena_size);
+        }
+
+        void retire() noexcept
+        {
+            unref();
+        }
+
+        void unref() noexcept
+        {
+            if(mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete this;
+        }
+
+        FreeSlab *pop() noexcept;
+        void push(FreeSlab *aSlab) noexcept;
+        bool grow();
+
+    private:
+        std::size_t             mMaxArenas;
+        bool                    mHugePages;
+        std::vector<void*>      mArenas; // owner's thread only
+
+        std::atomic<FreeSlab*>  mFree { nullptr };
+        std::atomic<std::size_t> mRefs { 1 }; // the owner + every slab given out
+        std::atomic<std::size_t> mHits { 0 };
+        std::atomic<std::size_t> mMisses { 0 };
+    };
+
+
+    inline char *BufferPool::allocate(std::size_t aSize)
+    {
+        FreeSlab *slab = nullptr;
+        if(aSize <= slab_size)
+        {
+            slab = pop();
+            if(!slab && grow())
+                slab = pop();
+        }
+
+        if(!slab)
+        {
+            mMisses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        mHits.fetch_add(1, std::memory_order_relaxed);
+        mRefs.fetch_add(1, std::memory_order_relaxed);
+
+        char *data = reinterpret_cast<char*>(slab);
+        auto header = new (data - sizeof(BufferHeader)) BufferHeader;
+        header->pool = this;
+        return data;
+    }
+
+    inline void BufferPool::release(char *aData) noexcept
+    {
+        reinterpret_cast<BufferHeader*>(aData - sizeof(BufferHeader))->~BufferHeader();
+        push(reinterpret_cast<FreeSlab*>(aData));
+        unref();
+    }
+
+    inline BufferPool::FreeSlab *BufferPool::pop() noexcept
+    {
+        // only the owner pops, so the top cannot be taken away and put back meanwhile
+        FreeSlab *top = mFree.load(std::memory_order_acquire);
+        while(top && !mFree.compare_exchange_weak(top, top->next, std::memory_order_acquire, std::memory_order_acquire))
+            ;
+        return top;
+    }
+
+    inline void BufferPool::push(FreeSlab *aSlab) noexcept
+    {
+        FreeSlab *top = mFree.load(std::memory_order_relaxed);
+        do {
+            aSlab->next = top;
+        } while(!mFree.compare_exchange_weak(top, aSlab, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    inline bool BufferPool::grow()
+    {
+        if(mArenas.size() >= mMaxArenas)
+            return false;
+
+        auto arena = static_cast<char*>(allocate_pages(arena_size, mHugePages));
+        if(!arena)
+            return false;
+        mArenas.push_back(arena);
+
+        for(std::size_t i = 0; i < slabs_per_arena; i++)
+            push(reinterpret_cast<FreeSlab*>(arena + i * stride + sizeof(BufferHeader)));
+        return true;
+    }
+
+}
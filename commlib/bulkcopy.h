@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <concepts>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UVCOMMS_STREAMING_STORES 1
+#endif
+
+namespace uvcomms4
+{
+    /// copies at least this big bypass the cache (a multi-megabyte message would only evict everything else)
+    inline constexpr std::size_t nontemporal_copy_threshold = 4 * 1024 * 1024;
+
+    /** A container of bytes that can be resized and written to through data(),
+     *  e.g. std::string or std::vector<char>
+    */
+    template<typename container_t>
+    concept ContiguousByteContainer = requires (container_t cont, std::size_t sz) {
+        { cont.data() } -> std::convertible_to<void const*>;
+        { cont.size() } -> std::convertible_to<std::size_t>;
+        { cont.resize(sz) };
+    } && sizeof(*std::declval<container_t&>().data()) == 1
+      && std::is_trivially_copyable_v<std::remove_reference_t<decltype(*std::declval<container_t&>().data())>>;
+
+
+    /** memcpy, with non-temporal stores where available if aNonTemporal
+     *  (for the parts of a copy totalling at least nontemporal_copy_threshold)
+    */
+    inline void bulk_copy(char *aDest, char const *aSrc, std::size_t aCount, bool aNonTemporal) noexcept
+    {
+#ifdef UVCOMMS_STREAMING_STORES
+        if(aNonTemporal && aCount >= 256)
+        {
+            // align the destination; the source may stay unaligned
+            std::size_t head = (16 - reinterpret_cast<std::uintptr_t>(aDest) % 16) % 16;
+            std::memcpy(aDest, aSrc, head);
+            aDest += head;
+            aSrc += head;
+            aCount -= head;
+
+            for(; aCount >= 64; aCount -= 64, aDest += 64, aSrc += 64)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(aSrc));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(aSrc + 16));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(aSrc + 32));
+                __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(aSrc + 48));
+                _mm_stream_si128(reinterpret_cast<__m128i*>(aDest), a);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(aDest + 16), b);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(aDest + 32), c);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(aDest + 48), d);
+            }
+            _mm_sfence(); // streaming stores are weakly ordered
+        }
+#else
+        (void)aNonTemporal;
+#endif
+        std::memcpy(aDest, aSrc, aCount);
+    }
+
+}
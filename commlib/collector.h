@@ -1,6 +1,8 @@
 #pragma once
 
 #include "pack.h"
+#include "bufferpool.h"
+#include "bulkcopy.h"
 #include <cstdlib>
 #include <list>
 #include <type_traits>
@@ -9,11 +11,19 @@
 #include <iterator>
 #include <algorithm>
 #include <cassert>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <new>
+#include <optional>
 
 
 namespace uvcomms4
 {
     /** A buffer to be held by the Collector
+     *  The data blocks are reference counted so that MessageViews can keep them alive
+     *  after the Collector has moved on
     */
     class ReadBuffer
     {
@@ -43,25 +53,243 @@ namespace uvcomms4
         ReadBuffer & operator = (ReadBuffer const &) = delete;
 
         char * data() noexcept { return mData; }
+        char const * data() const noexcept { return mData; }
         std::size_t size() const noexcept { return mSize; }
 
-        // to keep things toghether
-        static char *memalloc(std::size_t aSize)
+        /// another reference to the data block, to be released with memfree()
+        char * share() const noexcept
         {
-            return static_cast<char*>(std::malloc(aSize));
+            retain(mData);
+            return mData;
         }
 
+        /// no one else holds a reference to the data block (see share())
+        bool unique() const noexcept
+        {
+            return headerOf(mData)->refs.load(std::memory_order_acquire) == 1;
+        }
+
+        /// to keep things toghether; from aPool if it can help, otherwise from the heap
+        static char *memalloc(std::size_t aSize, BufferPool *aPool = nullptr)
+        {
+            if(aPool)
+                if(char *data = aPool->allocate(aSize))
+                    return data;
+
+            void *block = std::malloc(sizeof(BufferHeader) + aSize);
+            if(!block)
+                return nullptr;
+            new (block) BufferHeader;
+            return static_cast<char*>(block) + sizeof(BufferHeader);
+        }
+
+        /** Same as memalloc(), from memory backed by a temporary file (see map_spill()),
+         *  for data too big to keep in the heap
+        */
+        static char *memmap(std::size_t aSize)
+        {
+            std::size_t length = sizeof(MappedPrefix) + sizeof(BufferHeader) + aSize;
+            void *block = map_spill(length);
+            if(!block)
+                return nullptr;
+            new (block) MappedPrefix { length };
+            auto header = new (static_cast<char*>(block) + sizeof(MappedPrefix)) BufferHeader;
+            header->mapped = true;
+            return reinterpret_cast<char*>(header) + sizeof(BufferHeader);
+        }
+
+        /// the data block comes from memmap()
+        static bool mapped(char const * aData) noexcept
+        {
+            return aData && headerOf(const_cast<char*>(aData))->mapped;
+        }
+
+        /// releases a reference to the data block; the last one gives the memory back
         static void memfree(char * aData)
         {
-            std::free(aData);
+            if(!aData)
+                return;
+            BufferHeader *header = headerOf(aData);
+            if(header->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                if(header->pool)
+                    header->pool->release(aData);
+                else if(header->mapped)
+                {
+                    header->~BufferHeader();
+                    auto prefix = reinterpret_cast<MappedPrefix*>(reinterpret_cast<char*>(header) - sizeof(MappedPrefix));
+                    unmap_spill(prefix, prefix->length);
+                }
+                else
+                {
+                    header->~BufferHeader();
+                    std::free(header);
+                }
+            }
+        }
+
+        static void retain(char * aData) noexcept
+        {
+            if(aData)
+                headerOf(aData)->refs.fetch_add(1, std::memory_order_relaxed);
         }
 
     private:
+        struct alignas(std::max_align_t) MappedPrefix // precedes the header of a memmap() block
+        {
+            std::size_t length;
+        };
+
+        static BufferHeader *headerOf(char *aData) noexcept
+        {
+            return reinterpret_cast<BufferHeader*>(aData - sizeof(BufferHeader));
+        }
+
         char       *mData { nullptr };
         std::size_t mSize { 0 };
     };
 
 
+    /** A message left in place in the read buffers: a single segment if the message sits
+     *  in one buffer (the usual case), several if it crosses buffer boundaries.
+     *  Holds a reference to every buffer involved, so it remains valid after the Collector
+     *  has moved on and may be handed over to another thread.
+     *  Copying a view shares the buffers; nothing is allocated unless the message spans
+     *  more than inline_segments buffers.
+    */
+    class MessageView
+    {
+    public:
+        using segment_t = std::span<const char>;
+        static constexpr std::size_t inline_segments = 2;
+
+        MessageView() = default;
+
+        ~MessageView()
+        {
+            release();
+        }
+
+        MessageView(MessageView && aOther) noexcept
+        {
+            swap(aOther);
+        }
+
+        MessageView & operator = (MessageView && aOther) noexcept
+        {
+            MessageView(std::move(aOther)).swap(*this);
+            return *this;
+        }
+
+        MessageView(MessageView const & aOther)
+        {
+            for(std::size_t i = 0; i < aOther.mCount; i++)
+            {
+                Piece const & piece = aOther.piece(i);
+                ReadBuffer::retain(piece.block);
+                append(piece.block, piece.segment);
+            }
+        }
+
+        MessageView & operator = (MessageView const & aOther)
+        {
+            MessageView(aOther).swap(*this);
+            return *this;
+        }
+
+        void swap(MessageView & aOther) noexcept
+        {
+            std::swap(mInline, aOther.mInline);
+            std::swap(mOverflow, aOther.mOverflow);
+            std::swap(mCount, aOther.mCount);
+            std::swap(mSize, aOther.mSize);
+        }
+
+        /// message size in bytes
+        std::size_t size() const noexcept { return mSize; }
+
+        bool contiguous() const noexcept { return mCount <= 1; }
+
+        /// the whole message; only valid if contiguous()
+        segment_t span() const noexcept
+        {
+            assert(contiguous());
+            return mCount == 0 ? segment_t{} : piece(0).segment;
+        }
+
+        std::size_t segmentCount() const noexcept { return mCount; }
+
+        /// a contiguous view is a MessageableContainer, e.g. it can be written to a pipe as it is
+        char const * data() const noexcept { return span().data(); }
+        char const * begin() const noexcept { return data(); }
+        char const * end() const noexcept { return data() + mSize; }
+
+        /// the message has been spilled to a file mapping (see PiperOptions::spillThreshold)
+        bool spilled() const noexcept
+        {
+            return mCount > 0 && ReadBuffer::mapped(piece(0).block);
+        }
+
+        segment_t segment(std::size_t aIndex) const noexcept
+        {
+            return piece(aIndex).segment;
+        }
+
+        /// the message copied to a container that supports insert() at the end
+        template<typename container_t>
+        container_t copy() const
+        {
+            container_t container;
+            if constexpr(requires (container_t cont, std::size_t sz) { { cont.reserve(sz) }; })
+                container.reserve(mSize);
+            for(std::size_t i = 0; i < mCount; i++)
+                container.insert(std::end(container), piece(i).segment.begin(), piece(i).segment.end());
+            return container;
+        }
+
+        /// takes over a reference to aBlock (see ReadBuffer::share()) which contains aSegment
+        void append(char *aBlock, segment_t aSegment)
+        {
+            if(mCount < inline_segments)
+                mInline[mCount] = { aSegment, aBlock };
+            else
+            {
+                if(mCount == inline_segments)
+                    mOverflow.assign(std::begin(mInline), std::end(mInline));
+                mOverflow.push_back({ aSegment, aBlock });
+            }
+            ++mCount;
+            mSize += aSegment.size();
+        }
+
+    private:
+        struct Piece
+        {
+            segment_t   segment;
+            char       *block { nullptr };
+        };
+
+        Piece const & piece(std::size_t aIndex) const noexcept
+        {
+            return mCount <= inline_segments ? mInline[aIndex] : mOverflow[aIndex];
+        }
+
+        void release() noexcept
+        {
+            for(std::size_t i = 0; i < mCount; i++)
+                ReadBuffer::memfree(piece(i).block);
+            mCount = 0;
+            mSize = 0;
+            mOverflow.clear();
+        }
+
+        Piece               mInline[inline_segments];
+        std::vector<Piece>  mOverflow;
+        std::size_t         mCount { 0 };
+        std::size_t         mSize { 0 };
+    };
+
+
     static constexpr std::ptrdiff_t MORE_DATA = -1;
     static constexpr std::ptrdiff_t DATA_CORRUPT = -2;
 
@@ -88,6 +316,9 @@ namespace uvcomms4
     Invariants: a new message always starts in the current buffer; after extracting a message, we always remove the preceding buffers
     and adjust the position accordingly. Current position always points to the current (possibly incomplete) message header.
     Messages (and even message headers) may span across buffer boundaries.
+
+    The Collector keeps count of the buffered bytes and remembers the decoded length of the current message,
+    so status() is O(1) and every header is decoded once, however many reads a message takes to arrive.
     */
     template<CollectibleBuffer buffer_t>
     class CollectorT
@@ -101,6 +332,59 @@ namespace uvcomms4
         /// check if there's at least aSize bytes available ahead of the current position
         bool contains(std::size_t aSize) const;
 
+        /// number of bytes ahead of the current position
+        std::size_t bufferedBytes() const noexcept;
+
+        /// bytes still missing from the current message once its header has arrived; 0 otherwise
+        std::size_t expectedRemaining() noexcept;
+
+        /** If the current message still misses at least aMinRemaining bytes, moves it to a buffer of its own,
+         *  allocated at its final size, and returns the space left in that buffer for reading the rest
+         *  of the message into (see commit()); nothing else may be appended until the message is complete.
+         *  Once complete, the message is a single buffer that getMessageView() hands over without copying.
+         *  Returns the remaining space again if already reserved; empty if there is no such message
+         *  or the memory could not be obtained.
+         *  Messages of at least aSpillLength bytes (if nonzero) are reserved however much is missing,
+         *  in memory backed by a temporary file (buffer_t::memmap(), where available).
+        */
+        std::span<char> reserveMessage(std::size_t aMinRemaining = 1, std::size_t aSpillLength = 0)
+            requires requires (char *data, std::size_t size) {
+                { buffer_t::memalloc(size) } -> std::convertible_to<char*>;
+                buffer_t(data, size);
+            };
+
+        /// aData is the space returned by reserveMessage()
+        bool isReserved(char const *aData) const noexcept
+        {
+            return mReserved && aData == mReserved->data() + mReservedFilled;
+        }
+
+        /// aCount bytes have been read into the space returned by reserveMessage()
+        void commit(std::size_t aCount) noexcept;
+
+        /** Passes up to aCount bytes ahead of the current position to aSink, in place,
+         *  one std::span<const char> per buffer they are in, and moves past them.
+         *  Returns the number of bytes passed
+        */
+        template<std::invocable<std::span<const char>> sink_t>
+        std::size_t consume(std::size_t aCount, sink_t && aSink);
+
+        /// number of buffers held, the partially consumed one included
+        std::size_t bufferCount() const noexcept
+        {
+            return mBuffers.size();
+        }
+
+        /** Moves the unread data to a single buffer of its size and lets go of the buffers it came from
+         *  (these may be mostly empty, e.g. after many short reads, or shared with others);
+         *  not while a message is reserved. Returns false if the memory could not be obtained
+        */
+        bool compact()
+            requires requires (char *data, std::size_t size) {
+                { buffer_t::memalloc(size) } -> std::convertible_to<char*>;
+                buffer_t(data, size);
+            };
+
         /** Returns the current message length (nonnegative value),
          * or MORE_DATA if there's less than `header_size` bytes available,
          * or DATA_CORRUPT if the data is corrupt, meaning we should drop this connection
@@ -120,6 +404,19 @@ namespace uvcomms4
         template<typename container_t>
         std::tuple<CollectorStatus, container_t> getMessage();
 
+        /** Same as getMessage(), the container constructed with aAllocator;
+         *  e.g. getMessage<std::pmr::string>(aMemoryResource) (see also Piper::messageResource())
+        */
+        template<typename container_t, typename allocator_t>
+            requires std::constructible_from<container_t, allocator_t const &>
+        std::tuple<CollectorStatus, container_t> getMessage(allocator_t const & aAllocator);
+
+        /** Get the current message if exists, in place: the view shares the buffers
+         *  rather than copying the data out of them
+        */
+        std::tuple<CollectorStatus, MessageView> getMessageView()
+            requires requires (buffer_t buffer) { { buffer.share() } -> std::convertible_to<char*>; };
+
 
         /** Copy aCount bytes to aDest;
          * if aAdvance, adjust the current position and delete the no longer needed buffers.
@@ -143,11 +440,26 @@ namespace uvcomms4
         bool copyTo(container_t & aContainer, std::size_t aCount, bool aAdvance);
 
     private:
+        /// moves the current position aCount bytes ahead; there must be enough data
+        void skip(std::size_t aCount) noexcept;
 
+        /// the current position has moved: adjust the byte count and forget the decoded header
+        void advanced(std::size_t aCount) noexcept
+        {
+            mBuffered -= aCount;
+            mFrameLength = MORE_DATA;
+        }
 
     private:
         std::list<buffer_t>   mBuffers;
         std::size_t           mPos { 0 };
+        std::size_t           mBuffered { 0 }; // ahead of mPos, including mReservedFilled
+        std::ptrdiff_t        mFrameLength { MORE_DATA }; // the decoded header at mPos, if it's been decoded
+
+        // the current message while it's being read into a buffer of its own (see reserveMessage());
+        // it goes to mBuffers once complete
+        std::optional<buffer_t> mReserved;
+        std::size_t           mReservedFilled { 0 };
     };
 
     /// The Default Collector type used by Streamer
@@ -157,6 +469,8 @@ namespace uvcomms4
     template <CollectibleBuffer buffer_t>
     void CollectorT<buffer_t>::append(buffer_t &&aBuffer)
     {
+        assert(!mReserved);
+        mBuffered += aBuffer.size();
         mBuffers.emplace_back(std::forward<buffer_t>(aBuffer));
     }
 
@@ -164,24 +478,124 @@ namespace uvcomms4
     template <CollectibleBuffer buffer_t>
     inline bool CollectorT<buffer_t>::contains(std::size_t aSize) const
     {
-        auto pBuf = mBuffers.begin();
-        auto pos = mPos;
+        return aSize <= mBuffered;
+    }
+
+
+    template <CollectibleBuffer buffer_t>
+    inline std::size_t CollectorT<buffer_t>::bufferedBytes() const noexcept
+    {
+        return mBuffered;
+    }
+
+
+    template <CollectibleBuffer buffer_t>
+    inline std::size_t CollectorT<buffer_t>::expectedRemaining() noexcept
+    {
+        auto msglen = messageLength(false);
+        if(msglen < 0)
+            return 0;
+        std::size_t frame = header_size + std::size_t(msglen);
+        return frame > mBuffered ? frame - mBuffered : 0;
+    }
+
+
+    template <CollectibleBuffer buffer_t>
+    inline std::span<char> CollectorT<buffer_t>::reserveMessage(std::size_t aMinRemaining, std::size_t aSpillLength)
+        requires requires (char *data, std::size_t size) {
+            { buffer_t::memalloc(size) } -> std::convertible_to<char*>;
+            buffer_t(data, size);
+        }
+    {
+        if(!mReserved)
+        {
+            std::size_t remaining = expectedRemaining();
+            bool spill = remaining > 0 && aSpillLength > 0 && std::size_t(mFrameLength) >= aSpillLength;
+            if(remaining == 0 || (remaining < aMinRemaining && !spill))
+                return {};
+
+            // an incomplete message is the last thing in the Collector, header included
+            std::size_t frame = header_size + std::size_t(mFrameLength);
+            char *block = nullptr;
+            if constexpr(requires (std::size_t size) { { buffer_t::memmap(size) } -> std::convertible_to<char*>; })
+            {
+                if(spill)
+                    block = buffer_t::memmap(frame);
+            }
+            if(!block)
+                block = buffer_t::memalloc(frame);
+            if(!block)
+                return {};
+
+            mReserved.emplace(block, frame);
+            mReservedFilled = mBuffered;
+            copyTo(block, mBuffered, false);
+            mBuffers.clear();
+            mPos = 0;
+        }
 
-        while(aSize > 0)
+        return { mReserved->data() + mReservedFilled, mReserved->size() - mReservedFilled };
+    }
+
+
+    template <CollectibleBuffer buffer_t>
+    inline void CollectorT<buffer_t>::commit(std::size_t aCount) noexcept
+    {
+        mReservedFilled += aCount;
+        mBuffered += aCount;
+        if(mReservedFilled == mReserved->size())
         {
-            if(pBuf == mBuffers.end())
-                return false;
+            mBuffers.emplace_back(std::move(*mReserved));
+            mReserved.reset();
+        }
+    }
 
-            auto remainder = pBuf->size() - pos;
-            if(aSize <= remainder)
-                return true;
-            else
+
+    template <CollectibleBuffer buffer_t>
+    template <std::invocable<std::span<const char>> sink_t>
+    inline std::size_t CollectorT<buffer_t>::consume(std::size_t aCount, sink_t &&aSink)
+    {
+        std::size_t total = 0;
+        auto pBuf = mBuffers.begin();
+        auto pos = mPos;
+        while(total < aCount && pBuf != mBuffers.end())
+        {
+            auto to_take = std::min(aCount - total, pBuf->size() - pos);
+            aSink(std::span<const char>(pBuf->data() + pos, to_take));
+            total += to_take;
+            pos += to_take;
+            if(pos == pBuf->size())
             {
-                aSize -= remainder;
-                pBuf++;
                 pos = 0;
+                pBuf++;
             }
         }
+
+        mBuffers.erase(mBuffers.begin(), pBuf);
+        mPos = pos;
+        advanced(total);
+        return total;
+    }
+
+
+    template <CollectibleBuffer buffer_t>
+    inline bool CollectorT<buffer_t>::compact()
+        requires requires (char *data, std::size_t size) {
+            { buffer_t::memalloc(size) } -> std::convertible_to<char*>;
+            buffer_t(data, size);
+        }
+    {
+        if(mReserved || mBuffers.empty())
+            return true;
+
+        char *block = buffer_t::memalloc(mBuffered);
+        if(!block)
+            return false;
+
+        copyTo(block, mBuffered, false);
+        mBuffers.clear();
+        mBuffers.emplace_back(block, mBuffered);
+        mPos = 0; // the decoded header, if any, is still the same
         return true;
     }
 
@@ -189,20 +603,39 @@ namespace uvcomms4
     template <CollectibleBuffer buffer_t>
     inline std::ptrdiff_t CollectorT<buffer_t>::messageLength(bool aAdvance)
     {
-        char buffer[header_size];
-        if(!copyTo(buffer, header_size, aAdvance)) // if there's not enough data, aAdvance will have no effect
-            return MORE_DATA;
+        if(mFrameLength == MORE_DATA)
+        {
+            char buffer[header_size];
+            if(!copyTo(buffer, header_size, false)) // if there's not enough data, aAdvance will have no effect
+                return MORE_DATA;
 
-        std::uint32_t length = u32_unpack(buffer);
-        std::uint32_t lenhash = u32_unpack(buffer + 4);
+            std::uint32_t length = u32_unpack(buffer);
+            std::uint32_t lenhash = u32_unpack(buffer + 4);
 
-        if(length_hash(length) != lenhash)
-            return DATA_CORRUPT; // if the data is corrupt, aAdvance is no longer of concern
+            // if the data is corrupt, aAdvance is no longer of concern
+            mFrameLength = length_hash(length) == lenhash ? std::ptrdiff_t(length) : DATA_CORRUPT;
+        }
 
+        auto length = mFrameLength;
+        if(aAdvance && length >= 0)
+            skip(header_size);
         return length;
     }
 
 
+    template <CollectibleBuffer buffer_t>
+    inline void CollectorT<buffer_t>::skip(std::size_t aCount) noexcept
+    {
+        advanced(aCount);
+        aCount += mPos;
+        auto pBuf = mBuffers.begin();
+        while(pBuf != mBuffers.end() && aCount >= pBuf->size())
+            aCount -= (pBuf++)->size();
+        mBuffers.erase(mBuffers.begin(), pBuf);
+        mPos = aCount;
+    }
+
+
     template <CollectibleBuffer buffer_t>
     inline CollectorStatus CollectorT<buffer_t>::status()
     {
@@ -214,7 +647,7 @@ namespace uvcomms4
         case DATA_CORRUPT:
             return CollectorStatus::Corrupt;
         default:
-            return contains(msglen + header_size) ? CollectorStatus::HasMessage : CollectorStatus::NoMessage;
+            return contains(std::size_t(msglen) + header_size) ? CollectorStatus::HasMessage : CollectorStatus::NoMessage;
         };
     }
 
@@ -242,17 +675,65 @@ namespace uvcomms4
         {
             container_t container;
             extractMessageTo(container);
-            return { st, container };
+            return { st, std::move(container) };
         }
         else
             return { st, {} };
     }
 
 
+    template <CollectibleBuffer buffer_t>
+    template <typename container_t, typename allocator_t>
+        requires std::constructible_from<container_t, allocator_t const &>
+    inline std::tuple<CollectorStatus, container_t> CollectorT<buffer_t>::getMessage(allocator_t const &aAllocator)
+    {
+        container_t container(aAllocator);
+        CollectorStatus st = extractMessageTo(container);
+        return { st, std::move(container) };
+    }
+
+
+    template <CollectibleBuffer buffer_t>
+    inline std::tuple<CollectorStatus, MessageView> CollectorT<buffer_t>::getMessageView()
+        requires requires (buffer_t buffer) { { buffer.share() } -> std::convertible_to<char*>; }
+    {
+        if(CollectorStatus st = status(); st != CollectorStatus::HasMessage)
+            return { st, {} };
+
+        auto size = static_cast<std::size_t>(messageLength(true));
+
+        MessageView view;
+        auto pBuf = mBuffers.begin();
+        auto pos = mPos;
+        while(size > 0)
+        {
+            auto remainder = pBuf->size() - pos;
+            auto to_take = std::min(size, remainder);
+            view.append(pBuf->share(), { pBuf->data() + pos, to_take });
+            size -= to_take;
+            if(to_take < remainder)
+                pos += to_take;
+            else
+            {
+                pos = 0;
+                pBuf++;
+            }
+        }
+
+        mBuffers.erase(mBuffers.begin(), pBuf);
+        mPos = pos;
+        advanced(view.size());
+
+        return { CollectorStatus::HasMessage, std::move(view) };
+    }
+
+
     template <CollectibleBuffer buffer_t>
     template <std::output_iterator<char> iter_t>
     inline bool CollectorT<buffer_t>::copyTo(iter_t aDest, std::size_t aCount, bool aAdvance)
     {
+        auto const count = aCount;
+        bool const nonTemporal = aCount >= nontemporal_copy_threshold;
         auto pBuf = mBuffers.begin();
         auto pos = mPos;
         while(aCount > 0)
@@ -262,7 +743,13 @@ namespace uvcomms4
 
             auto remainder = pBuf->size() - pos;
             auto to_copy = std::min(aCount, remainder);
-            aDest = std::copy(pBuf->data() + pos, pBuf->data() + pos + to_copy, aDest);
+            if constexpr(std::is_same_v<iter_t, char*>)
+            {
+                bulk_copy(aDest, pBuf->data() + pos, to_copy, nonTemporal);
+                aDest += to_copy;
+            }
+            else
+                aDest = std::copy(pBuf->data() + pos, pBuf->data() + pos + to_copy, aDest);
             aCount -= to_copy;
             if(to_copy < remainder)
                 pos += to_copy;
@@ -277,6 +764,7 @@ namespace uvcomms4
         {
             mBuffers.erase(mBuffers.begin(), pBuf);
             mPos = pos;
+            advanced(count);
         }
 
         return true;
@@ -288,14 +776,27 @@ namespace uvcomms4
         requires requires(container_t cont, char c) { { cont.push_back(c) };  }
     inline bool CollectorT<buffer_t>::copyTo(container_t &aContainer, std::size_t aCount, bool aAdvance)
     {
-        if constexpr(requires (container_t cont, std::size_t sz) {
-            { cont.size() } -> std::convertible_to<std::size_t>;
-            { cont.reserve(sz) };
-        })
+        if constexpr(ContiguousByteContainer<container_t>)
+        {
+            // resize once and copy buffer by buffer
+            std::size_t available = std::min(aCount, mBuffered - (mReserved ? mReservedFilled : 0));
+            std::size_t size = aContainer.size();
+            aContainer.resize(size + available);
+            char *dest = reinterpret_cast<char*>(aContainer.data()) + size;
+            copyTo(dest, available, aAdvance && available == aCount);
+            return available == aCount;
+        }
+        else
         {
-            aContainer.reserve(aContainer.size() + aCount);
+            if constexpr(requires (container_t cont, std::size_t sz) {
+                { cont.size() } -> std::convertible_to<std::size_t>;
+                { cont.reserve(sz) };
+            })
+            {
+                aContainer.reserve(aContainer.size() + aCount);
+            }
+            return copyTo(std::back_inserter(aContainer), aCount, aAdvance);
         }
-        return copyTo(std::back_inserter(aContainer), aCount, aAdvance);
     }
 
 }
\ No newline at end of file
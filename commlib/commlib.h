@@ -3,6 +3,7 @@
 #include <string>
 #include <system_error>
 #include <cstdint>
+#include <cstddef>
 
 namespace uvcomms4
 {
@@ -49,4 +50,42 @@ void adjust_resource_limits();
 */
 void configure_signals();
 
+/** Only makes sense on UNIX: duplicates a file descriptor so that it outlives
+ * the uv handle it was obtained from (used to hand accepted connections over to another loop).
+ * Returns the new descriptor or a negative POSIX error code; always fails on Windows
+*/
+int duplicate_fd(int aFd);
+
+/** Closes a file descriptor obtained with duplicate_fd() */
+void close_fd(int aFd);
+
+/** Allocates aSize bytes of page-aligned memory (for buffer pools); with aHugePages, tries
+ * huge pages first (Linux: MAP_HUGETLB, then transparent huge pages), falling back to regular ones.
+ * Returns nullptr on failure
+*/
+void *allocate_pages(std::size_t aSize, bool aHugePages);
+
+/** Releases memory obtained from allocate_pages() */
+void free_pages(void *aPtr, std::size_t aSize);
+
+/** Maps aSize bytes (a multiple of the page size) twice, back to back, so that the second half
+ * mirrors the first: a ring buffer over this memory never has to wrap.
+ * Linux only (memfd); returns nullptr on failure and on the other systems
+*/
+void *map_mirrored(std::size_t aSize);
+
+/** Releases memory obtained from map_mirrored() */
+void unmap_mirrored(void *aPtr, std::size_t aSize);
+
+/** Maps aSize bytes of memory backed by an unlinked temporary file, so that the system may write it out
+ * and drop it under memory pressure rather than keep it resident (Linux: O_TMPFILE in $TMPDIR or /tmp,
+ * falling back to memfd; macOS: mkstemp(); Windows: the paging file).
+ * The storage is reserved up front, so writing to the mapping cannot run out of room later.
+ * Returns nullptr on failure, including when there is not enough room
+*/
+void *map_spill(std::size_t aSize);
+
+/** Releases memory obtained from map_spill() */
+void unmap_spill(void *aPtr, std::size_t aSize);
+
 }
\ No newline at end of file
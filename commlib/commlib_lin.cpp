@@ -5,7 +5,10 @@
 #include <sys/un.h>
 #include <sys/resource.h>
 #include <signal.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <cassert>
+#include <cstdlib>
 
 namespace uvcomms4
 {
@@ -89,4 +92,96 @@ namespace uvcomms4
         setrlimit(RLIMIT_NOFILE, &rlp);
     }
 
-}
\ No newline at end of file
+    int duplicate_fd(int aFd)
+    {
+        int r = dup(aFd);
+        return r < 0 ? -errno : r;
+    }
+
+    void close_fd(int aFd)
+    {
+        close(aFd); // not retrying on EINTR: the descriptor is released anyway
+    }
+
+    void *allocate_pages(std::size_t aSize, bool aHugePages)
+    {
+        void *p = MAP_FAILED;
+        if(aHugePages) // only succeeds if huge pages have been reserved (vm.nr_hugepages)
+            p = mmap(nullptr, aSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if(p == MAP_FAILED)
+        {
+            p = mmap(nullptr, aSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(p == MAP_FAILED)
+                return nullptr;
+            if(aHugePages)
+                madvise(p, aSize, MADV_HUGEPAGE); // a hint; failure is not an error
+        }
+
+        return p;
+    }
+
+    void free_pages(void *aPtr, std::size_t aSize)
+    {
+        if(aPtr)
+            munmap(aPtr, aSize);
+    }
+
+    void *map_mirrored(std::size_t aSize)
+    {
+        int fd = memfd_create("uvcomms4-ring", MFD_CLOEXEC);
+        if(fd < 0)
+            return nullptr;
+
+        // reserve the address range first so that nothing else can get in between the halves
+        char *p = nullptr;
+        void *range = MAP_FAILED;
+        if(ftruncate(fd, aSize) == 0)
+            range = mmap(nullptr, 2 * aSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if(range != MAP_FAILED)
+        {
+            p = static_cast<char*>(range);
+            if(mmap(p, aSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+                || mmap(p + aSize, aSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+            {
+                munmap(range, 2 * aSize);
+                p = nullptr;
+            }
+        }
+
+        close(fd); // the mappings keep the memory
+        return p;
+    }
+
+    void unmap_mirrored(void *aPtr, std::size_t aSize)
+    {
+        if(aPtr)
+            munmap(aPtr, 2 * aSize);
+    }
+
+    void *map_spill(std::size_t aSize)
+    {
+        char const *dir = getenv("TMPDIR");
+        int fd = open(dir && *dir ? dir : "/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if(fd < 0)
+            fd = memfd_create("uvcomms4-spill", MFD_CLOEXEC);
+        if(fd < 0)
+            return nullptr;
+
+        // reserve the blocks now: writing to a sparse file that finds no room means SIGBUS
+        void *p = MAP_FAILED;
+        if(posix_fallocate(fd, 0, static_cast<off_t>(aSize)) == 0)
+            p = mmap(nullptr, aSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        close(fd); // the mapping keeps the file
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void unmap_spill(void *aPtr, std::size_t aSize)
+    {
+        if(aPtr)
+            munmap(aPtr, aSize);
+    }
+
+}
@@ -5,7 +5,10 @@
 #include <sys/un.h>
 #include <sys/resource.h>
 #include <signal.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <cassert>
+#include <cstdlib>
 #include <iostream>
 
 namespace uvcomms4
@@ -91,4 +94,70 @@ namespace uvcomms4
         signal(SIGPIPE, SIG_IGN);
     }
 
-}
\ No newline at end of file
+    int duplicate_fd(int aFd)
+    {
+        int r = dup(aFd);
+        return r < 0 ? -errno : r;
+    }
+
+    void close_fd(int aFd)
+    {
+        close(aFd); // not retrying on EINTR: the descriptor is released anyway
+    }
+
+    void *allocate_pages(std::size_t aSize, bool)
+    {
+        // no MAP_HUGETLB here; the kernel decides on superpages by itself
+        void *p = mmap(nullptr, aSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void free_pages(void *aPtr, std::size_t aSize)
+    {
+        if(aPtr)
+            munmap(aPtr, aSize);
+    }
+
+    void *map_mirrored(std::size_t)
+    {
+        return nullptr; // no memfd; the ring compacts instead
+    }
+
+    void unmap_mirrored(void *, std::size_t)
+    {
+
+    }
+
+    void *map_spill(std::size_t aSize)
+    {
+        char const *dir = getenv("TMPDIR");
+        std::string path = std::string(dir && *dir ? dir : "/tmp") + "/uvcomms4-spill.XXXXXX";
+        int fd = mkstemp(path.data());
+        if(fd < 0)
+            return nullptr;
+        unlink(path.c_str());
+
+        // reserve the blocks now: writing to a sparse file that finds no room means SIGBUS
+        fstore_t store { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(aSize), 0 };
+        bool reserved = fcntl(fd, F_PREALLOCATE, &store) != -1;
+        if(!reserved)
+        {
+            store.fst_flags = F_ALLOCATEALL; // not necessarily contiguous
+            reserved = fcntl(fd, F_PREALLOCATE, &store) != -1;
+        }
+
+        void *p = MAP_FAILED;
+        if(reserved && ftruncate(fd, static_cast<off_t>(aSize)) == 0)
+            p = mmap(nullptr, aSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        close(fd); // the mapping keeps the file
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void unmap_spill(void *aPtr, std::size_t aSize)
+    {
+        if(aPtr)
+            munmap(aPtr, aSize);
+    }
+
+}
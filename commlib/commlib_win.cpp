@@ -1,4 +1,9 @@
 #include "commlib.h"
+#include <cerrno>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
 
 namespace uvcomms4
 {
@@ -48,4 +53,55 @@ namespace uvcomms4
 
     }
 
-}
\ No newline at end of file
+    int duplicate_fd(int)
+    {
+        return -ENOTSUP;
+    }
+
+    void close_fd(int)
+    {
+
+    }
+
+    void *allocate_pages(std::size_t aSize, bool)
+    {
+        // large pages require SeLockMemoryPrivilege; not worth it here
+        return VirtualAlloc(nullptr, aSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    void free_pages(void *aPtr, std::size_t)
+    {
+        if(aPtr)
+            VirtualFree(aPtr, 0, MEM_RELEASE);
+    }
+
+    void *map_mirrored(std::size_t)
+    {
+        return nullptr; // possible with placeholder mappings (Windows 10+), not done yet
+    }
+
+    void unmap_mirrored(void *, std::size_t)
+    {
+
+    }
+
+    void *map_spill(std::size_t aSize)
+    {
+        // backed by the paging file rather than by the process' private memory;
+        // committed at once (no SEC_RESERVE), so it fails here if the paging file has no room for it
+        HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+            static_cast<DWORD>(static_cast<unsigned long long>(aSize) >> 32), static_cast<DWORD>(aSize), nullptr);
+        if(!mapping)
+            return nullptr;
+        void *p = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, aSize);
+        CloseHandle(mapping); // the view keeps the mapping
+        return p;
+    }
+
+    void unmap_spill(void *aPtr, std::size_t)
+    {
+        if(aPtr)
+            UnmapViewOfFile(aPtr);
+    }
+
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+/** Completion tokens: a cheaper alternative to the future<>-returning Piper overloads
+ *  for threads that block until their requests are done.
+ *  A token lives on the waiting thread's stack (no shared state is allocated) and hands
+ *  a callback to the callback overload of a request:
+ *
+ *      Completion<int> done;
+ *      piper.write(pipe, std::move(message), done.callback());
+ *      int errCode = done.wait();
+ *
+ *  Batch waits for several requests with a single wakeup:
+ *
+ *      Batch batch(messages.size());
+ *      for(auto & m: messages)
+ *          piper.write(pipe, std::move(m), batch.callback());
+ *      int firstErrCode = batch.wait();
+ *
+ *  Waiting on the IO thread deadlocks, just like future<>::get().
+ *  A token must not be destroyed before wait() returns (or ready() yields true).
+*/
+
+namespace uvcomms4
+{
+    namespace detail
+    {
+        /** The signalling part shared by the tokens.
+         *  The waiter spins for a while, then sleeps in std::atomic::wait.
+         *  The notifying side touches the token after the wake-up call, so the waiter
+         *  does not leave wait() until it sees the final 'done' state.
+        */
+        class CompletionSignal
+        {
+        public:
+            static constexpr int spin_count = 4096;
+
+            bool ready() const noexcept
+            {
+                return mState.load(std::memory_order_acquire) == done;
+            }
+
+            void wait() const noexcept
+            {
+                for(int i = 0; i < spin_count; i++)
+                    if(ready())
+                        return;
+
+                mState.wait(pending, std::memory_order_acquire);
+
+                while(!ready())
+                    std::this_thread::yield(); // the notifier is about to finish
+            }
+
+            void signal() noexcept
+            {
+                mState.store(notifying, std::memory_order_release);
+                mState.notify_all();
+                mState.store(done, std::memory_order_release);
+            }
+
+        private:
+            static constexpr std::uint32_t pending = 0;
+            static constexpr std::uint32_t notifying = 1;
+            static constexpr std::uint32_t done = 2;
+
+            std::atomic<std::uint32_t>  mState { pending };
+        };
+
+        /// the UV error code of a request's result: int for write/close, (descriptor, int) for listen/connect
+        inline int errorCodeOf(int aResult) noexcept
+        {
+            return aResult;
+        }
+
+        template<typename first_t>
+        int errorCodeOf(std::tuple<first_t, int> const & aResult) noexcept
+        {
+            return std::get<1>(aResult);
+        }
+    }
+
+
+    /** One-shot completion of a single request; value_t is the request's result type
+     *  (int for write/close, std::tuple<Descriptor, int> for listen/connect)
+    */
+    template<typename value_t>
+    class Completion
+    {
+    public:
+        Completion() = default;
+        Completion(Completion const &) = delete;
+        Completion & operator = (Completion const &) = delete;
+
+        /// pass this to the callback overload of the request; one request per token
+        auto callback() noexcept
+        {
+            return [this](value_t aValue) {
+                set(std::move(aValue));
+            };
+        }
+
+        void set(value_t aValue) noexcept(std::is_nothrow_move_constructible_v<value_t>)
+        {
+            mValue.emplace(std::move(aValue));
+            mSignal.signal();
+        }
+
+        bool ready() const noexcept
+        {
+            return mSignal.ready();
+        }
+
+        /// blocks until the request is done; returns its result
+        value_t wait()
+        {
+            mSignal.wait();
+            return std::move(*mValue);
+        }
+
+    private:
+        std::optional<value_t>      mValue;
+        detail::CompletionSignal    mSignal;
+    };
+
+
+    /** Completion of a known number of requests, possibly of different kinds.
+     *  The waiter is woken up once, when the last of them is done.
+    */
+    class Batch
+    {
+    public:
+        explicit Batch(std::size_t aCount) noexcept :
+            mRemaining(aCount)
+        {
+            if(aCount == 0)
+                mSignal.signal();
+        }
+
+        Batch(Batch const &) = delete;
+        Batch & operator = (Batch const &) = delete;
+
+        /// pass this to the callback overload of each of the requests
+        auto callback() noexcept
+        {
+            return [this] <typename result_t> (result_t && aResult) {
+                complete(detail::errorCodeOf(aResult));
+            };
+        }
+
+        void complete(int aErrCode) noexcept
+        {
+            if(aErrCode != 0)
+            {
+                mFailures.fetch_add(1, std::memory_order_relaxed);
+                int expected = 0;
+                mFirstError.compare_exchange_strong(expected, aErrCode, std::memory_order_relaxed);
+            }
+
+            if(mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                mSignal.signal();
+        }
+
+        bool ready() const noexcept
+        {
+            return mSignal.ready();
+        }
+
+        /// blocks until all the requests are done; returns the first error code reported, or 0
+        int wait() noexcept
+        {
+            mSignal.wait();
+            return mFirstError.load(std::memory_order_relaxed);
+        }
+
+        /// number of requests that have failed so far
+        std::size_t failures() const noexcept
+        {
+            return mFailures.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<std::size_t>    mRemaining;
+        std::atomic<std::size_t>    mFailures { 0 };
+        std::atomic<int>            mFirstError { 0 };
+        detail::CompletionSignal    mSignal;
+    };
+
+}
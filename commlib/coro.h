@@ -0,0 +1,246 @@
+#pragma once
+
+#include "piper.h"
+#include <coroutine>
+#include <optional>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <exception>
+
+/** Awaitable versions of Piper's requests.
+ *  A coroutine suspended on any of these is resumed on the IO thread directly from the
+ *  request's completion (no future/promise involved), so everything after the first co_await
+ *  runs on the IO thread, like any other completion callback.
+*/
+
+namespace uvcomms4::coro
+{
+    /** Fire-and-forget coroutine: starts running immediately and destroys itself when done.
+     *  An exception escaping the coroutine terminates the program.
+    */
+    struct Task
+    {
+        struct promise_type
+        {
+            Task get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+
+    /** Suspends the coroutine, hands a completion callback to aSubmit and resumes with
+     *  the value the callback receives
+    */
+    template<typename retval_t, typename submit_t>
+    class RequestAwaiter
+    {
+    public:
+        explicit RequestAwaiter(submit_t && aSubmit) :
+            mSubmit(std::move(aSubmit))
+        {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> aHandle)
+        {
+            // N.B. the coroutine may be resumed (and this awaiter destroyed) before mSubmit returns
+            mSubmit([this, aHandle](retval_t aRetval) {
+                mResult.emplace(aRetval);
+                aHandle.resume();
+            });
+        }
+
+        retval_t await_resume()
+        {
+            return *mResult;
+        }
+
+    private:
+        submit_t                mSubmit;
+        std::optional<retval_t> mResult;
+    };
+
+    template<typename retval_t, typename submit_t>
+    RequestAwaiter<retval_t, std::decay_t<submit_t>> makeAwaiter(submit_t && aSubmit)
+    {
+        return RequestAwaiter<retval_t, std::decay_t<submit_t>>(std::forward<submit_t>(aSubmit));
+    }
+
+
+    /// co_await: the listener's descriptor + error code
+    inline auto listen(Piper & aPiper, std::string aListenAddress)
+    {
+        return makeAwaiter<std::tuple<Descriptor, int>>(
+            [&aPiper, address = std::move(aListenAddress)] <typename callback_t> (callback_t && aCallback) {
+                aPiper.listen(address, std::forward<callback_t>(aCallback));
+            });
+    }
+
+    /// co_await: the new pipe's descriptor + error code
+    inline auto connect(Piper & aPiper, std::string aConnectAddress)
+    {
+        return makeAwaiter<std::tuple<Descriptor, int>>(
+            [&aPiper, address = std::move(aConnectAddress)] <typename callback_t> (callback_t && aCallback) {
+                aPiper.connect(address, std::forward<callback_t>(aCallback));
+            });
+    }
+
+    /// co_await: the UV result code once the message has been written
+    template<requests::MessageableContainer container_t>
+    inline auto write(Piper & aPiper, Descriptor aPipeDescriptor, container_t && aContainer)
+    {
+        return makeAwaiter<int>(
+            [&aPiper, aPipeDescriptor, container = std::forward<container_t>(aContainer)]
+            <typename callback_t> (callback_t && aCallback) mutable {
+                aPiper.write(aPipeDescriptor, std::move(container), std::forward<callback_t>(aCallback));
+            });
+    }
+
+    /// co_await: the UV result code once the pipe has been closed
+    inline auto close(Piper & aPiper, Descriptor aPipeDescriptor)
+    {
+        return makeAwaiter<int>(
+            [&aPiper, aPipeDescriptor] <typename callback_t> (callback_t && aCallback) {
+                aPiper.close(aPipeDescriptor, std::forward<callback_t>(aCallback));
+            });
+    }
+
+
+    /** Incoming messages, sorted by descriptor, for coroutines to co_await on.
+     *  The delegate feeds it by forwarding its onMessage() and onPipeClosed() calls;
+     *  a coroutine receives the messages of one pipe with `co_await streams.next(descriptor)`,
+     *  which yields std::nullopt once the pipe has been closed and its messages consumed.
+     *  Only one coroutine at a time may wait on a given descriptor.
+     *  Messages of pipes nobody waits for are kept until they are consumed, and so is the close
+     *  of a pipe nobody has waited for yet, so every stream should be drained until the end.
+    */
+    template<requests::MessageableContainer message_t = std::string>
+    class MessageStreams
+    {
+        struct Stream
+        {
+            std::deque<message_t>       messages;
+            bool                        closed { false };
+            std::coroutine_handle<>     waiter;
+            std::optional<message_t>   *result { nullptr }; // where the waiter expects its message
+        };
+
+    public:
+        class NextAwaiter
+        {
+        public:
+            NextAwaiter(MessageStreams & aStreams, Descriptor aDescriptor) :
+                mStreams(aStreams), mDescriptor(aDescriptor)
+            {}
+
+            bool await_ready()
+            {
+                std::lock_guard lk(mStreams.mMx);
+                return mStreams.take(mDescriptor, mResult);
+            }
+
+            bool await_suspend(std::coroutine_handle<> aHandle)
+            {
+                std::lock_guard lk(mStreams.mMx);
+                if(mStreams.take(mDescriptor, mResult))
+                    return false; // arrived meanwhile
+                Stream & stream = mStreams.mStreams[mDescriptor];
+                stream.waiter = aHandle;
+                stream.result = &mResult;
+                return true;
+            }
+
+            std::optional<message_t> await_resume()
+            {
+                return std::move(mResult);
+            }
+
+        private:
+            MessageStreams             &mStreams;
+            Descriptor                  mDescriptor;
+            std::optional<message_t>    mResult;
+        };
+
+        /// co_await: the next message of the pipe, or std::nullopt if it's closed
+        NextAwaiter next(Descriptor aDescriptor)
+        {
+            return NextAwaiter(*this, aDescriptor);
+        }
+
+        /// call from PiperDelegate::onMessage
+        void onMessage(Descriptor aDescriptor, Collector & aCollector)
+        {
+            auto [status, message] = aCollector.getMessage<message_t>();
+            if(status != CollectorStatus::HasMessage)
+                return;
+
+            std::coroutine_handle<> waiter;
+            {
+                std::lock_guard lk(mMx);
+                Stream & stream = mStreams[aDescriptor];
+                if(stream.waiter)
+                {
+                    stream.result->emplace(std::move(message));
+                    waiter = std::exchange(stream.waiter, nullptr);
+                }
+                else
+                    stream.messages.push_back(std::move(message));
+            }
+            if(waiter)
+                waiter.resume();
+        }
+
+        /// call from PiperDelegate::onPipeClosed
+        void onPipeClosed(Descriptor aDescriptor)
+        {
+            std::coroutine_handle<> waiter;
+            {
+                std::lock_guard lk(mMx);
+                Stream & stream = mStreams[aDescriptor]; // closed before anything came: the next() to come gets nullopt
+                if(stream.waiter)
+                {
+                    waiter = stream.waiter;
+                    mStreams.erase(aDescriptor); // the waiter gets nullopt
+                }
+                else
+                    stream.closed = true;
+            }
+            if(waiter)
+                waiter.resume();
+        }
+
+    private:
+        // under lock; false if there's nothing to take yet
+        bool take(Descriptor aDescriptor, std::optional<message_t> & aResult)
+        {
+            auto found = mStreams.find(aDescriptor);
+            if(found == mStreams.end())
+                return false;
+
+            Stream & stream = found->second;
+            if(!stream.messages.empty())
+            {
+                aResult.emplace(std::move(stream.messages.front()));
+                stream.messages.pop_front();
+                return true;
+            }
+
+            if(stream.closed)
+            {
+                mStreams.erase(found); // the end has been observed
+                return true;
+            }
+
+            return false;
+        }
+
+    private:
+        std::mutex                      mMx;
+        std::map<Descriptor, Stream>    mStreams;
+    };
+
+}
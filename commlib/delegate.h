@@ -2,7 +2,9 @@
 
 #include "commlib.h"
 #include "collector.h"
+#include "ringcollector.h"
 #include <memory>
+#include <span>
 
 namespace uvcomms4
 {
@@ -11,6 +13,9 @@ namespace uvcomms4
     We stop the loop in destructor and certain events may arrive when the descendant class has already been destroyed,
     so we can end up with a pure virtual call.
     Solution: use delegation instead
+
+    With PiperOptions::ioThreads > 1, the "IO thread" callbacks below are called on the IO thread
+    that owns the pipe in question, so callbacks for different pipes may run concurrently.
     */
 
     class Piper;
@@ -52,12 +57,52 @@ namespace uvcomms4
 
         /** Called when a new complete incoming message becomes available.
          *  Called on the IO thread and the supplied Collector must only be accessed from the IO thread;
-         *  Extract the message before moving to another thread.
+         *  Extract the message before moving to another thread
+         *  (Collector::getMessageView() takes it in place, without copying).
+         *  A delegate that cannot take the message right now may leave it in the Collector:
+         *  the pipe's messages are then offered again when more data arrives or on Piper::resumeReading()
+         *  (see also PiperOptions::readBufferLimit).
          *  Not allowed to throw.
          */
         virtual void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept = 0;
-    };
 
+        /** Same as onMessage(), for a Piper that collects incoming data with a RingCollector
+         *  (see PiperOptions::collector); the message is taken in place with peekMessage() + popMessage().
+         *  Only called if takesRingMessages() says so.
+         *  Not allowed to throw.
+        */
+        virtual void onRingMessage(Descriptor aDescriptor, RingCollector & aCollector) noexcept {}
+
+        /** Override to return true along with onRingMessage(); a Piper whose delegate does not take
+         *  ring messages collects with the List collector, whatever PiperOptions::collector says
+        */
+        virtual bool takesRingMessages() const noexcept { return false; }
+
+        /** With PiperOptions::streamingThreshold, messages at least that long are not collected:
+         *  once the header has arrived, the delegate gets onMessageBegin() with the message length,
+         *  then the body in pieces, as they are read, with onMessageChunk(), then onMessageEnd().
+         *  A chunk is only valid during the call. Messages of a pipe keep their order; the ones below
+         *  the threshold still come with onMessage(). If the pipe gets closed midway,
+         *  there is no onMessageEnd(), only onPipeClosed().
+         *  Called on the IO thread. Not allowed to throw.
+        */
+        virtual void onMessageBegin(Descriptor aDescriptor, std::size_t aLength) noexcept {}
+        virtual void onMessageChunk(Descriptor aDescriptor, std::span<const char> aChunk) noexcept {}
+        virtual void onMessageEnd(Descriptor aDescriptor) noexcept {}
+
+        /** Called on the IO thread when the data queued for writing to the pipe has exceeded
+         *  PiperOptions::writeHighWatermark, i.e. the other side does not keep up; a good time
+         *  to stop producing for this pipe.
+         *  Not allowed to throw.
+        */
+        virtual void onWriteBlocked(Descriptor aPipe) noexcept {}
 
+        /** Called on the IO thread when the data queued for writing to a pipe that has been reported
+         *  by onWriteBlocked() has dropped to PiperOptions::writeLowWatermark.
+         *  Not called if the pipe gets closed meanwhile.
+         *  Not allowed to throw.
+        */
+        virtual void onWritable(Descriptor aPipe) noexcept {}
+    };
 
 }
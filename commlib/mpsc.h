@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <concepts>
+
+namespace uvcomms4
+{
+    /** Intrusive link for MPSCQueue
+    */
+    struct MPSCNode
+    {
+        std::atomic<MPSCNode*> mpscNext { nullptr };
+    };
+
+    /** Intrusive multiple-producer/single-consumer queue (D. Vyukov's algorithm).
+     *  push() is wait-free (one exchange + one store) and may be called from any thread;
+     *  pop() must only be called by the consumer thread.
+     *  pop() may return nullptr while a push() is half-way through (the producer has been preempted
+     *  between its two steps), so a producer must signal the consumer after push() returns, not before.
+     *  The queue does not own the nodes.
+    */
+    template<std::derived_from<MPSCNode> node_t>
+    class MPSCQueue
+    {
+    public:
+        MPSCQueue() = default;
+        MPSCQueue(MPSCQueue const &) = delete;
+        MPSCQueue & operator = (MPSCQueue const &) = delete;
+
+        void push(node_t *aNode) noexcept
+        {
+            pushNode(aNode);
+        }
+
+        node_t *pop() noexcept
+        {
+            MPSCNode *tail = mTail;
+            MPSCNode *next = tail->mpscNext.load(std::memory_order_acquire);
+
+            if(tail == &mStub)
+            {
+                if(!next)
+                    return nullptr; // empty
+                mTail = next;
+                tail = next;
+                next = next->mpscNext.load(std::memory_order_acquire);
+            }
+
+            if(next)
+            {
+                mTail = next;
+                return static_cast<node_t*>(tail);
+            }
+
+            if(tail != mHead.load(std::memory_order_acquire))
+                return nullptr; // a producer is in the middle of push()
+
+            // tail is the last node; put the stub behind it so that tail can be detached
+            pushNode(&mStub);
+
+            next = tail->mpscNext.load(std::memory_order_acquire);
+            if(next)
+            {
+                mTail = next;
+                return static_cast<node_t*>(tail);
+            }
+
+            return nullptr;
+        }
+
+    private:
+        void pushNode(MPSCNode *aNode) noexcept
+        {
+            aNode->mpscNext.store(nullptr, std::memory_order_relaxed);
+            MPSCNode *prev = mHead.exchange(aNode, std::memory_order_acq_rel);
+            prev->mpscNext.store(aNode, std::memory_order_release);
+        }
+
+    private:
+        MPSCNode                mStub;
+        std::atomic<MPSCNode*>  mHead { &mStub }; // producers push here
+        MPSCNode               *mTail { &mStub }; // consumer only
+    };
+
+}
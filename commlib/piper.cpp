@@ -3,25 +3,29 @@
 #include <optional>
 #include <system_error>
 #include <cassert>
+#include <algorithm>
+#include <bit>
+#include <limits>
 
 namespace uvcomms4
 {
-    Piper::Piper(PiperDelegate::pointer aDelegate) :
-        mDelegate(aDelegate)
+    Piper::Piper(PiperDelegate::pointer aDelegate, PiperOptions const & aOptions) :
+        mDelegate(aDelegate),
+        mOptions(effectiveOptions(*aDelegate, aOptions)),
+        mReadBufferPool(makeReadBufferPool(mOptions))
     {
-        std::promise<void> initPromise;
-        std::future<void> initFuture = initPromise.get_future();
+        if(mOptions.collector != aOptions.collector)
+            std::cerr << "WARNING: the delegate does not take ring messages; collecting with the List collector\n";
 
-        mIOThread = std::thread([pms = std::move(initPromise), this]()mutable {
-            threadFunction(std::move(pms));
-        });
+        startIOThread();
 
         final_act fin_thread{[this] { mIOThread.join(); }};
-        initFuture.get(); // UB sanitizer barks on this (invalid vptr etc) if we get an exception from the IO thread;
-        // however, that seems to be a false positive. Possible explanation: https://stackoverflow.com/questions/57294792/c-ubsan-produces-false-positives-with-derived-objects
+        final_act fin_stop([this] { requestStop(); } );
 
+        std::size_t ioThreads = std::clamp<std::size_t>(mOptions.ioThreads, 1, max_io_threads);
+        for(std::size_t i = 1; i < ioThreads; i++)
+            mShards.emplace_back(new Piper(aDelegate, mOptions, i)); // private constructor
 
-        final_act fin_stop([this] { requestStop(); } );
         mDelegate->Startup(this);
 
         fin_stop.cancel();
@@ -29,11 +33,76 @@ namespace uvcomms4
     }
 
 
+    Piper::Piper(PiperDelegate::pointer aDelegate, PiperOptions const & aOptions, std::size_t aShardIndex) :
+        mDelegate(aDelegate),
+        mOptions(aOptions),
+        mReadBufferPool(makeReadBufferPool(aOptions)),
+        mShardIndex(aShardIndex)
+    {
+        startIOThread();
+    }
+
+
     Piper::~Piper()
     {
-        mDelegate->Shutdown();
+        if(0 == mShardIndex)
+            mDelegate->Shutdown();
         requestStop();
         mIOThread.join();
+        mShards.clear(); // after the listeners are gone so no more connections are handed over
+
+        // posted after the loop had stopped
+        while(requests::Request *req = mPendingRequests.pop())
+            delete req;
+    }
+
+
+    PiperOptions Piper::effectiveOptions(PiperDelegate const & aDelegate, PiperOptions const & aOptions)
+    {
+        PiperOptions options = aOptions;
+        if(options.collector != ReadCollector::List && !aDelegate.takesRingMessages())
+            options.collector = ReadCollector::List; // copying every message out of the ring would be slower than a list
+        return options;
+    }
+
+
+    BufferPool::pointer Piper::makeReadBufferPool(PiperOptions const & aOptions)
+    {
+        if(aOptions.readBufferPoolSlabs == 0 || aOptions.collector != ReadCollector::List)
+            return nullptr;
+        return BufferPool::create(aOptions.readBufferPoolSlabs, aOptions.readBufferHugePages);
+    }
+
+
+    BufferPoolStats Piper::readBufferPoolStats() const noexcept
+    {
+        BufferPoolStats total;
+        if(mReadBufferPool)
+            total = mReadBufferPool->stats();
+        for(auto & aShard: mShards)
+        {
+            BufferPoolStats shardStats = aShard->readBufferPoolStats();
+            total.hits += shardStats.hits;
+            total.misses += shardStats.misses;
+        }
+        return total;
+    }
+
+
+    void Piper::startIOThread()
+    {
+        std::promise<void> initPromise;
+        std::future<void> initFuture = initPromise.get_future();
+
+        mIOThread = std::thread([pms = std::move(initPromise), this]()mutable {
+            threadFunction(std::move(pms));
+        });
+
+        final_act fin_thread{[this] { mIOThread.join(); }};
+        initFuture.get(); // UB sanitizer barks on this (invalid vptr etc) if we get an exception from the IO thread;
+        // however, that seems to be a false positive. Possible explanation: https://stackoverflow.com/questions/57294792/c-ubsan-produces-false-positives-with-derived-objects
+
+        fin_thread.cancel();
     }
 
 
@@ -78,10 +147,7 @@ namespace uvcomms4
 
     void Piper::requestStop()
     {
-        {
-            std::lock_guard lk(mMx);
-            mStopFlag = true;
-        }
+        mStopFlag.store(true);
         triggerAsync();
     }
 
@@ -90,13 +156,11 @@ namespace uvcomms4
     {
         requireIOThread();
 
-        bool stopRequested = false;
-        {
-            std::lock_guard lk(mMx);
-            stopRequested = mStopFlag;
-        }
+        // requests posted from now on need another wakeup;
+        // acq_rel: whatever the producer that has set the flag had pushed is visible to us
+        mAsyncPending.exchange(false, std::memory_order_acq_rel);
 
-        if(stopRequested)
+        if(mStopFlag.load())
         {
             uv_stop(aAsync->loop);
             processPendingRequests(true); // true means Abort
@@ -120,52 +184,149 @@ namespace uvcomms4
     {
 #ifdef UVCOMMS_THREAD_CHECKS
         assert(std::this_thread::get_id() != mIOThreadId);
+        for(auto & aShard: mShards)
+            aShard->requireNonIOThread();
 #endif
     }
 
+    Piper & Piper::shard(std::size_t aIndex) noexcept
+    {
+        return aIndex == 0 ? *this : *mShards[aIndex - 1];
+    }
+
+    Piper & Piper::shardOf(Descriptor aDescriptor) noexcept
+    {
+        // unknown/garbage descriptors go to this shard which will answer UV_ENOTCONN
+        auto index = static_cast<std::size_t>(aDescriptor >> shard_shift);
+        return index <= mShards.size() ? shard(index) : *this;
+    }
+
+    void Piper::postFanoutWrite(std::span<const Descriptor> aPipeDescriptors, SharedPayload const & aPayload,
+        std::shared_ptr<requests::FanoutCompletion> const & aCompletion)
+    {
+        if(aPipeDescriptors.empty())
+        {// still completes on the IO thread
+            postRequest(requests::makeFanoutWriteRequest(mRequestPool, {}, aPayload, aCompletion));
+            return;
+        }
+
+        std::vector<std::vector<Descriptor>> perShard(mShards.size() + 1);
+        for(Descriptor descriptor: aPipeDescriptors)
+            perShard[shardOf(descriptor).mShardIndex].push_back(descriptor);
+
+        for(std::size_t i = 0; i < perShard.size(); i++)
+        {
+            if(perShard[i].empty())
+                continue;
+            Piper & target = shard(i);
+            target.postRequest(requests::makeFanoutWriteRequest(target.mRequestPool, std::move(perShard[i]), aPayload, aCompletion));
+        }
+    }
+
+    std::pmr::memory_resource *Piper::messageResource(Descriptor aPipeDescriptor) noexcept
+    {
+        Piper & target = shardOf(aPipeDescriptor);
+        target.requireIOThread();
+        return &target.mMessageResource;
+    }
+
+    Piper & Piper::nextShard() noexcept
+    {
+        if(mShards.empty())
+            return *this;
+        return shard(mNextShard.fetch_add(1, std::memory_order_relaxed) % (mShards.size() + 1));
+    }
+
     Descriptor Piper::nextDescriptor()
     {
-        return mNextDescriptor++;
+        static_assert(shard_shift >= std::bit_width(SlotMap<UVPipe*>::key_mask));
+        // the slot stays empty until the pipe is registered
+        return (static_cast<Descriptor>(mShardIndex) << shard_shift)
+            | static_cast<Descriptor>(mPipes.insert(nullptr));
     }
 
     void Piper::triggerAsync() // any thread
     {
-        uv_async_send(&mAsyncTrigger);
+        // at most one uv_async_send() per batch: the consumer clears the flag before draining the queue
+        if(!mAsyncPending.exchange(true, std::memory_order_acq_rel))
+            uv_async_send(&mAsyncTrigger);
     }
 
     void Piper::postRequest(requests::Request::pointer aRequest) // any thread
     {
+        // On the IO thread (typically, a delegate or completion callback) there's no need to go
+        // through the queue and wait for another loop iteration; unless we're shutting down,
+        // in which case the loop may no longer be running
+        if(std::this_thread::get_id() == mIOThreadId && !mStopFlag.load(std::memory_order_relaxed))
         {
-            std::lock_guard lk(mMx);
-            mPendingRequests.emplace_back(std::move(aRequest));
+            if(mCallbackDepth > 0)
+                mDeferredRequests.push_back(aRequest.release());
+            else
+            {
+                CallbackScope scope(this); // flushes the writes, if any
+                aRequest.release()->dispatchToHandler(this);
+            }
+            return;
         }
-        triggerAsync();
+
+        mPendingRequests.push(aRequest.release());
+        triggerAsync(); // must follow push(), see MPSCQueue
     }
 
     void Piper::processPendingRequests(bool aAbort)
     {
         requireIOThread();
 
-        mPendingRequestsTemporary.clear();
-        {
-            std::lock_guard lk(mMx);
-            mPendingRequestsTemporary.swap(mPendingRequests);
-        }
+        // don't let a flood of requests starve the loop; the rest will be processed on the next iteration
+        constexpr std::size_t max_batch = 4096;
 
-        if(aAbort)
+        std::size_t count = 0;
+        while(requests::Request *req = mPendingRequests.pop())
         {
-            for(std::unique_ptr<requests::Request> & req: mPendingRequestsTemporary)
+            if(aAbort)
+            {
                 req->abort();
+                delete req;
+            }
+            else
+            {
+                // once dispatched, request lifetime is the handler's responsibility
+                req->dispatchToHandler(this);
+                if(++count == max_batch)
+                {
+                    triggerAsync();
+                    break;
+                }
+            }
         }
-        else
+
+    }
+
+    void Piper::dispatchDeferredRequests()
+    {
+        requireIOThread();
+        // requests posted by the handlers are appended to the same list;
+        // N.B. handlers may grow the vector, so no iterators here
+        for(std::size_t i = 0; i < mDeferredRequests.size(); i++)
+            mDeferredRequests[i]->dispatchToHandler(this);
+        mDeferredRequests.clear();
+    }
+
+    void Piper::leaveCallbacks()
+    {
+        requireIOThread();
+        // whatever the handlers and completions post meanwhile is deferred and picked up
+        // by the next round rather than recursing
+        ++mCallbackDepth;
+        while(!mDeferredRequests.empty() || !mFlushPending.empty())
         {
-            // once dispatched, request lifetime is the handler's responsibility
-            for(std::unique_ptr<requests::Request> & req: mPendingRequestsTemporary)
-                req.release()->dispatchToHandler(this);
+            dispatchDeferredRequests();
+            flushWrites();
         }
+        --mCallbackDepth;
 
-        mPendingRequestsTemporary.clear();
-
+        // back to the initial arena; what the callbacks have allocated is gone
+        mMessageResource.release();
     }
 
     void Piper::onClosed(Descriptor aPipe, int aErrCode)
@@ -175,28 +336,43 @@ namespace uvcomms4
         mDelegate->onPipeClosed(aPipe, aErrCode);
     }
 
+    Piper::UVPipe *Piper::pipeCreate()
+    {
+        requireIOThread();
+        Descriptor descriptor = nextDescriptor();
+        UVPipe *thePipe = UVPipe::init(descriptor, mRunningLoop, false);
+        if(!thePipe)
+            pipeUnregister(descriptor);
+        return thePipe;
+    }
+
     void Piper::pipeRegister(UVPipe *aPipe)
     {
         requireIOThread();
-        auto found = mPipes.find(aPipe->descriptor());
-        assert(found == mPipes.end()); // this would be Piper logic error
-        mPipes.insert({ aPipe->descriptor(), aPipe });
+        UVPipe **slot = pipeSlot(aPipe->descriptor());
+        assert(slot && !*slot); // this would be Piper logic error
+        *slot = aPipe;
     }
 
     void Piper::pipeUnregister(Descriptor aDescriptor)
     {
         requireIOThread();
-        auto found = mPipes.find(aDescriptor);
-        if(found != mPipes.end())
-            mPipes.erase(found);
+        if(pipeSlot(aDescriptor))
+            mPipes.erase(static_cast<std::uint64_t>(aDescriptor) & SlotMap<UVPipe*>::key_mask);
     }
 
     Piper::UVPipe *Piper::pipeGet(Descriptor aDescriptor)
     {
         requireIOThread();
-        auto found = mPipes.find(aDescriptor);
-        return found == mPipes.end() ?
-            nullptr : found->second;
+        UVPipe **slot = pipeSlot(aDescriptor);
+        return slot ? *slot : nullptr;
+    }
+
+    Piper::UVPipe **Piper::pipeSlot(Descriptor aDescriptor)
+    {
+        if(static_cast<std::size_t>(aDescriptor >> shard_shift) != mShardIndex)
+            return nullptr;
+        return mPipes.find(static_cast<std::uint64_t>(aDescriptor) & SlotMap<UVPipe*>::key_mask);
     }
 
 //================================================================================================================
@@ -209,7 +385,7 @@ namespace uvcomms4
         std::unique_ptr<requests::ListenRequest> theReq(aListenRequest);
 
         auto [listeningPipe, errCode] = [&, this]() -> std::tuple<UVPipe*, int> {
-            UVPipe* listeningPipe = UVPipe::init(nextDescriptor(), mRunningLoop, false);
+            UVPipe* listeningPipe = pipeCreate();
             if(!listeningPipe)
                 return { nullptr, UV_ERRNO_MAX };
             if(int r = listeningPipe->bind(theReq->listenAddress.c_str()); r < 0)
@@ -221,7 +397,8 @@ namespace uvcomms4
 
         if(errCode != 0)
         {
-            listeningPipe->close();
+            if(listeningPipe)
+                listeningPipe->close();
             theReq->fulfill({0, errCode});
         }
         else
@@ -250,9 +427,18 @@ namespace uvcomms4
             return;
         }
 
-        UVPipe *client = UVPipe::init(nextDescriptor(), mRunningLoop, false);
         UVPipe *server = UVPipe::fromHandle(aServer);
 
+#ifndef _WIN32
+        if(Piper & target = nextShard(); &target != this)
+        {
+            handOverConnection(aServer, server->descriptor(), target);
+            return;
+        }
+#endif
+
+        UVPipe *client = pipeCreate();
+
         if(!client)
         {
             std::cerr << "WARNING: error creating a new pipe for incoming connection\n";
@@ -280,6 +466,80 @@ namespace uvcomms4
     }
 
 
+    void Piper::handOverConnection(uv_stream_t *aServer, Descriptor aListener, Piper & aTarget)
+    {
+        requireIOThread();
+
+        detail::TransientPipe *accepted = detail::TransientPipe::init(mRunningLoop);
+        if(!accepted)
+        {
+            std::cerr << "WARNING: error creating a new pipe for incoming connection\n";
+            return;
+        }
+
+        final_act fin_close([accepted] { accepted->close(); }); // the duplicate descriptor stays open
+
+        if(int r = uv_accept(aServer, *accepted); r < 0)
+        {
+            std::cerr << "WARNING: error accepting incoming connection: "
+                << std::error_code(-r, std::system_category()).message()
+                << std::endl;
+            return;
+        }
+
+        uv_os_fd_t fd;
+        int r = uv_fileno(*accepted, &fd);
+        if(r == 0)
+            r = duplicate_fd(fd);
+
+        if(r < 0)
+        {
+            std::cerr << "WARNING: error handing over incoming connection: "
+                << std::error_code(-r, std::system_category()).message()
+                << std::endl;
+            return;
+        }
+
+        aTarget.postRequest(requests::makeAdoptRequest(aListener, r));
+    }
+
+
+    void Piper::handleAdoptRequest(requests::AdoptRequest *aAdoptRequest)
+    {
+        requireIOThread();
+        std::unique_ptr<requests::AdoptRequest> theReq(aAdoptRequest);
+
+        UVPipe *client = pipeCreate();
+        if(!client)
+        {
+            std::cerr << "WARNING: error creating a new pipe for incoming connection\n";
+            return;
+        }
+
+        if(int r = client->open(theReq->fd); r < 0)
+        {
+            std::cerr << "WARNING: error opening incoming connection: "
+                << std::error_code(-r, std::system_category()).message()
+                << std::endl;
+            client->close();
+            return;
+        }
+
+        theReq->fd = -1; // owned by the pipe now
+
+        if(int r = client->read_start(); r < 0)
+        {
+            std::cerr << "WARNING: error reading from incoming connection: "
+                << std::error_code(-r, std::system_category()).message()
+                << std::endl;
+        }
+
+        pipeRegister(client);
+
+        mDelegate->onNewConnection(theReq->listener, client->descriptor());
+    }
+
+
 //================================================================================================================
 // READING
 //================================================================================================================
@@ -288,13 +548,23 @@ namespace uvcomms4
         requireIOThread();
         UVPipe *thePipe = UVPipe::fromHandle(aStream);
 
+        // with a RingCollector or a reserved message, the buffer belongs to the collector
+        bool collectorOwned = thePipe->mRing || thePipe->collector().isReserved(aBuf->base);
+        bool shared = mSharedReadBufferLent && aBuf->base == mSharedReadBuffer->data();
+        if(shared)
+            mSharedReadBufferLent = false;
+        auto releaseBuffer = [collectorOwned, shared, aBuf] {
+            if(!collectorOwned && !shared)
+                ReadBuffer::memfree(aBuf->base);
+        };
+
         if(aNread == UV_EOF)
         {
-            ReadBuffer::memfree(aBuf->base);
+            releaseBuffer();
 
             // this callback does not add new data so there's no need to check the Collector for complete messages
             // but we might want to know if there's an incomplete message?
-            if(thePipe->collector().contains(1))
+            if(thePipe->bufferedBytes() > 0 || thePipe->mStreamRemaining > 0)
                 std::cerr << "WARNING: end of stream reached but there's a (possibly) icomplete message in the read buffer!\n";
 
             thePipe->close(0);
@@ -302,7 +572,7 @@ namespace uvcomms4
         }
         else if(aNread < 0)
         {
-            ReadBuffer::memfree(aBuf->base);
+            releaseBuffer();
             thePipe->close((int)aNread);
             // immediately delete the pipe from the descriptor table?
         }
@@ -310,35 +580,262 @@ namespace uvcomms4
         {
             // N.B. zero length reads are possible, avoid adding such buffers
             // zero-length messages are allowed but they will have at least 8 bytes of header
-            Collector & collector = thePipe->collector();
-
-            if(aNread > 0)
-                collector.append(ReadBuffer{aBuf->base, (std::size_t)aNread});
+            if(aNread == 0)
+                releaseBuffer();
+            else if(thePipe->mRing)
+                thePipe->mRing->commit((std::size_t)aNread);
+            else if(collectorOwned)
+                thePipe->collector().commit((std::size_t)aNread);
+            else if(shared)
+                thePipe->collector().append(ReadBuffer{mSharedReadBuffer->share(), (std::size_t)aNread});
             else
-                ReadBuffer::memfree(aBuf->base);
+            {
+                thePipe->noteRead((std::size_t)aNread, aBuf->len);
+                thePipe->collector().append(ReadBuffer{aBuf->base, (std::size_t)aNread});
+            }
+
+            deliverMessages(thePipe);
+            if(shared)
+                thePipe->collector().compact(); // whatever is left; views taken by the delegate keep sharing the buffer
+            else if(!thePipe->mRing)
+                compactCollector(thePipe);
+        }
+
+    }
+
+    namespace
+    {
+        template<typename collector_t>
+        CollectorStatus offerMessages(PiperDelegate & aDelegate, Descriptor aPipe, collector_t & aCollector,
+            void (PiperDelegate::*aCallback)(Descriptor, collector_t &) noexcept)
+        {
+            CollectorStatus status;
+            while((status = aCollector.status()) == CollectorStatus::HasMessage)
+            {
+                std::size_t buffered = aCollector.bufferedBytes();
+                (aDelegate.*aCallback)(aPipe, aCollector);
+                if(aCollector.bufferedBytes() == buffered)
+                    break; // the delegate has left the message for later (see resumeReading)
+            }
+            return status;
+        }
+    }
+
+    void Piper::deliverMessages(UVPipe *aPipe)
+    {
+        CollectorStatus status;
+        if(aPipe->mRing)
+            status = offerMessages(*mDelegate, aPipe->descriptor(), *aPipe->mRing, &PiperDelegate::onRingMessage);
+        else if(mOptions.streamingThreshold > 0)
+            status = streamMessages(aPipe);
+        else
+            status = offerMessages(*mDelegate, aPipe->descriptor(), aPipe->collector(), &PiperDelegate::onMessage);
+
+        if(status == CollectorStatus::Corrupt)
+        {
+            aPipe->close(UV_ECONNABORTED);
+            return;
+        }
+
+        // an incomplete message does not count: it can only be completed by reading on
+        if(mOptions.readBufferLimit > 0)
+            aPipe->mReadThrottled = status == CollectorStatus::HasMessage
+                && aPipe->bufferedBytes() > mOptions.readBufferLimit;
+
+        updateReading(aPipe);
+    }
 
-            while(collector.status() == CollectorStatus::HasMessage)
-               mDelegate->onMessage(thePipe->descriptor(), collector);
+    CollectorStatus Piper::streamMessages(UVPipe *aPipe)
+    {
+        Collector &collector = aPipe->collector();
+        Descriptor descriptor = aPipe->descriptor();
+        for(;;)
+        {
+            if(aPipe->mStreamRemaining > 0)
+            {
+                aPipe->mStreamRemaining -= collector.consume(aPipe->mStreamRemaining, [&](std::span<const char> aChunk) {
+                    mDelegate->onMessageChunk(descriptor, aChunk);
+                });
+                if(aPipe->mStreamRemaining > 0)
+                    return CollectorStatus::NoMessage; // the Collector is empty
+                mDelegate->onMessageEnd(descriptor);
+            }
 
-            if(collector.status() == CollectorStatus::Corrupt)
-                thePipe->close(UV_ECONNABORTED);
+            auto length = collector.messageLength(false);
+            if(length >= 0 && std::size_t(length) >= mOptions.streamingThreshold)
+            {
+                collector.messageLength(true); // the body follows
+                aPipe->mStreamRemaining = std::size_t(length);
+                mDelegate->onMessageBegin(descriptor, aPipe->mStreamRemaining);
+                continue;
             }
 
+            if(CollectorStatus status = collector.status(); status != CollectorStatus::HasMessage)
+                return status;
+
+            std::size_t buffered = collector.bufferedBytes();
+            mDelegate->onMessage(descriptor, collector);
+            if(collector.bufferedBytes() == buffered)
+                return CollectorStatus::HasMessage; // the delegate has left the message for later (see resumeReading)
+        }
+    }
+
+    void Piper::updateReading(UVPipe *aPipe)
+    {
+        if(aPipe->isClosing() || aPipe->isListener())
+            return;
+
+        bool shouldRead = !aPipe->mReadPaused && !aPipe->mReadThrottled;
+        if(shouldRead == aPipe->isReading())
+            return;
+
+        if(int r = shouldRead ? aPipe->read_start() : aPipe->read_stop(); r < 0)
+        {
+            std::cerr << "WARNING: error " << (shouldRead ? "resuming" : "pausing") << " reading: "
+                << std::error_code(-r, std::system_category()).message()
+                << std::endl;
+        }
+    }
+
+    void Piper::handleFanoutWriteRequest(requests::FanoutWriteRequest *aReq)
+    {
+        requireIOThread();
+        std::unique_ptr<requests::FanoutWriteRequest> theReq(aReq);
+
+        if(theReq->descriptors.empty())
+        {
+            theReq->completion->finish(0);
+            return;
+        }
+
+        // each pipe queues its own reference to the payload, subject to the same checks as any write;
+        // the last one takes over ours, so that the completion comes after every reference has gone
+        SharedPayload payload = std::move(theReq->payload);
+        std::size_t count = theReq->descriptors.size();
+        for(std::size_t i = 0; i < count; i++)
+        {
+            auto req = requests::makePayloadWriteRequest(mRequestPool, theReq->descriptors[i], payload, theReq->completion);
+            if(i + 1 == count)
+                payload = {};
+            handleWriteRequest(req.release());
+        }
+    }
+
+    void Piper::handleReadControlRequest(requests::ReadControlRequest *aReq)
+    {
+        requireIOThread();
+        std::unique_ptr<requests::ReadControlRequest> theReq(aReq);
+
+        UVPipe *thePipe = pipeGet(theReq->descriptor);
+        if(!thePipe || thePipe->isListener() || thePipe->isClosing())
+            return; // nothing to report to
+
+        thePipe->mReadPaused = theReq->pause;
+        if(theReq->pause)
+            updateReading(thePipe);
+        else
+        {
+            thePipe->mReadThrottled = false; // unless the delegate still leaves too much
+            deliverMessages(thePipe);
+        }
     }
 
     void Piper::onAlloc(uv_handle_t *aHandle, size_t aSuggested_size, uv_buf_t *aBuf)
     {
         requireIOThread();
         UVPipe *thePipe = UVPipe::fromHandle(aHandle);
-        std::size_t to_allocate = thePipe->recvBuferSize();
-        if(to_allocate == 0)
-            to_allocate = aSuggested_size;
 
-        aBuf->base = ReadBuffer::memalloc(to_allocate);
+        if(mOptions.collector != ReadCollector::List)
+        {
+            if(!thePipe->mRing)
+                thePipe->mRing.reset(new (std::nothrow) RingCollector(mOptions.collector == ReadCollector::MirroredRing));
+
+            std::span<char> space;
+            if(thePipe->mRing)
+                space = thePipe->mRing->writable(std::max(RingCollector::min_capacity / 2, thePipe->mRing->expectedRemaining()));
+            aBuf->base = space.data();
+            aBuf->len = space.size();
+            return;
+        }
+
+        if(mOptions.directReadThreshold > 0 || mOptions.spillThreshold > 0)
+        {
+            std::size_t minRemaining = mOptions.directReadThreshold > 0 ? mOptions.directReadThreshold : std::numeric_limits<std::size_t>::max();
+            if(std::span<char> space = thePipe->collector().reserveMessage(minRemaining, mOptions.spillThreshold); !space.empty())
+            {
+                aBuf->base = space.data();
+                aBuf->len = space.size();
+                return;
+            }
+        }
+
+        if(mOptions.sharedReadBuffer)
+        {
+            if(char *shared = lendSharedReadBuffer())
+            {
+                aBuf->base = shared;
+                aBuf->len = shared_read_buffer_size;
+                return;
+            }
+        }
+
+        std::size_t to_allocate = readBufferSize(thePipe, aSuggested_size);
+
+        // a small buffer would take a whole slab
+        BufferPool *pool = to_allocate > BufferPool::slab_size / 2 ? mReadBufferPool.get() : nullptr;
+        aBuf->base = ReadBuffer::memalloc(to_allocate, pool);
         aBuf->len = aBuf->base ? to_allocate : 0;
     }
 
 
+    std::size_t Piper::readBufferSize(UVPipe *aPipe, std::size_t aSuggested)
+    {
+        std::size_t maxSize = aPipe->recvBuferSize();
+        if(maxSize == 0)
+            maxSize = aSuggested;
+
+        if(mOptions.minReadBufferSize == 0)
+            return maxSize;
+        return aPipe->nextReadSize(std::min(mOptions.minReadBufferSize, maxSize), maxSize);
+    }
+
+
+    char *Piper::lendSharedReadBuffer()
+    {
+        if(mSharedReadBufferLent)
+            return nullptr;
+
+        // held by MessageViews: leave it to them
+        if(mSharedReadBuffer && !mSharedReadBuffer->unique())
+            mSharedReadBuffer.reset();
+
+        if(!mSharedReadBuffer)
+        {
+            char *data = ReadBuffer::memalloc(shared_read_buffer_size);
+            if(!data)
+                return nullptr;
+            mSharedReadBuffer.emplace(data, shared_read_buffer_size);
+        }
+
+        mSharedReadBufferLent = true;
+        return mSharedReadBuffer->data();
+    }
+
+
+    void Piper::compactCollector(UVPipe *aPipe)
+    {
+        Collector &collector = aPipe->collector();
+        std::size_t count = collector.bufferCount();
+        if(mOptions.compactBufferCount == 0 || count < mOptions.compactBufferCount)
+            return;
+
+        // the buffers are read into at about this size, so the average fill tells how much of them is wasted
+        std::size_t readSize = readBufferSize(aPipe, BufferPool::slab_size);
+        if(collector.bufferedBytes() / count <= readSize / 4)
+            collector.compact(); // if it fails, the buffers simply stay
+    }
+
+
 //================================================================================================================
 // CONNECTING
 //================================================================================================================
@@ -348,7 +845,7 @@ namespace uvcomms4
         requireIOThread();
         std::unique_ptr<requests::ConnectRequest> theReq(aConnectRequest);
 
-        UVPipe *connectedPipe = UVPipe::init(nextDescriptor(), mRunningLoop, false);
+        UVPipe *connectedPipe = pipeCreate();
         if(!connectedPipe)
         {
             theReq->fulfill({0, UV_ERRNO_MAX});
@@ -412,29 +909,148 @@ namespace uvcomms4
             return;
         }
 
-        uv_buf_t buffers[] {
-            uv_buf_init(theReq->header, sizeof(theReq->header)),
-            uv_buf_init(const_cast<char*>(theReq->data()), static_cast<unsigned>(theReq->size()))
-        };
+        std::size_t highWatermark = mOptions.writeHighWatermark;
+        if(highWatermark > 0 && mOptions.failWritesAboveHighWatermark && outstandingBytes(thePipe) > highWatermark)
+        {
+            theReq->fulfill(UV_EAGAIN);
+            return;
+        }
+
+        if(theReq->bufferCount() == 0)
+        {
+            theReq->fulfill(0); // an empty batch
+            return;
+        }
 
-        int r = uv_write(&theReq->uv_write_request, *thePipe,
-            buffers, std::size(buffers), &detail::cb<Piper>::write);
+        // written once the current batch of requests has been dispatched
+        thePipe->mQueuedBytes += theReq->byteCount();
+        thePipe->mWriteQueue.push_back(std::move(theReq));
+        scheduleFlush(thePipe);
 
-        if(0 == r)
-            theReq.release();
-        else
-            theReq->fulfill(r);
+        if(highWatermark > 0 && !thePipe->mWriteBlocked && outstandingBytes(thePipe) > highWatermark)
+        {
+            thePipe->mWriteBlocked = true;
+            mDelegate->onWriteBlocked(thePipe->descriptor());
+        }
+    }
+
+
+    std::size_t Piper::outstandingBytes(UVPipe *aPipe)
+    {
+        return aPipe->mQueuedBytes + uv_stream_get_write_queue_size(*aPipe);
+    }
+
+
+    void Piper::checkWritable(UVPipe *aPipe)
+    {
+        if(aPipe->mWriteBlocked && !aPipe->isClosing() && outstandingBytes(aPipe) <= mOptions.writeLowWatermark)
+        {
+            aPipe->mWriteBlocked = false;
+            mDelegate->onWritable(aPipe->descriptor());
+        }
+    }
+
+
+    void Piper::scheduleFlush(UVPipe *aPipe)
+    {
+        if(!aPipe->mFlushScheduled && !aPipe->mWriting)
+        {
+            aPipe->mFlushScheduled = true;
+            mFlushPending.push_back(aPipe->descriptor());
+        }
+    }
+
+
+    void Piper::flushWrites()
+    {
+        requireIOThread();
+        // by descriptor: a pipe may have been closed and destroyed since it was scheduled
+        for(Descriptor descriptor: mFlushPending)
+        {
+            if(UVPipe *thePipe = pipeGet(descriptor))
+            {
+                thePipe->mFlushScheduled = false;
+                flushWrites(thePipe);
+            }
+        }
+        mFlushPending.clear();
+    }
+
+
+    void Piper::flushWrites(UVPipe *aPipe)
+    {
+        // completions are called on the way, but whatever they post is deferred (see leaveCallbacks)
+        while(!aPipe->mWriting && !aPipe->mWriteQueue.empty() && !aPipe->isClosing())
+        {
+            // gather as many queued messages as fit in one writev()
+            mWriteBuffers.clear();
+            std::size_t total = 0;
+            while(!aPipe->mWriteQueue.empty())
+            {
+                auto & req = aPipe->mWriteQueue.front();
+                std::size_t buffers = req->bufferCount();
+                if(!mWriteBuffers.empty() && mWriteBuffers.size() + buffers > max_write_buffers)
+                    break; // a request too big for a single writev() goes on its own; libuv splits it
+
+                for(std::size_t i = 0; i < buffers; i++)
+                {
+                    if(std::span<const char> buffer = req->buffer(i); !buffer.empty())
+                        mWriteBuffers.push_back(uv_buf_init(const_cast<char*>(buffer.data()), static_cast<unsigned>(buffer.size())));
+                }
+                total += req->byteCount();
+                aPipe->mQueuedBytes -= req->byteCount();
+                aPipe->mWritesInFlight.push_back(std::move(req));
+                aPipe->mWriteQueue.pop_front();
+            }
+
+            // often, the socket buffer can take it all right away
+            int r = uv_try_write(*aPipe, mWriteBuffers.data(), static_cast<unsigned>(mWriteBuffers.size()));
+            if(r == UV_EAGAIN || r == UV_ENOSYS)
+                r = 0;
+
+            if(r >= 0 && static_cast<std::size_t>(r) == total)
+            {
+                aPipe->completeWrites(0);
+                continue;
+            }
+
+            if(r >= 0)
+            {
+                // the rest goes asynchronously
+                uv_buf_t *first = mWriteBuffers.data();
+                auto written = static_cast<std::size_t>(r);
+                while(written >= first->len)
+                    written -= (first++)->len;
+                first->base += written;
+                first->len -= static_cast<decltype(first->len)>(written);
+
+                auto remaining = static_cast<unsigned>(mWriteBuffers.data() + mWriteBuffers.size() - first);
+                r = uv_write(&aPipe->mWriteRequest, *aPipe, first, remaining, &detail::cb<Piper>::write);
+                if(r == 0)
+                {
+                    aPipe->mWriting = true;
+                    return;
+                }
+            }
+
+            aPipe->completeWrites(r);
+        }
+
+        checkWritable(aPipe);
     }
 
 
     void Piper::onWrite(uv_write_t *aReq, int aStatus)
     {
         requireIOThread();
-        std::unique_ptr<requests::WriteRequest> theReq(
-            static_cast<requests::WriteRequest*>(aReq->data)
-        );
+        UVPipe *thePipe = UVPipe::fromHandle(aReq->handle);
 
-        theReq->fulfill(aStatus);
+        thePipe->mWriting = false;
+        thePipe->completeWrites(aStatus);
+        if(!thePipe->mWriteQueue.empty())
+            scheduleFlush(thePipe); // queued while this write was in progress
+        else
+            checkWritable(thePipe);
     }
 
 //================================================================================================================
@@ -456,6 +1072,7 @@ namespace uvcomms4
             // request will be fulfilled when the pipe is actually destroyed
             if(!thePipe->setCloseRequest(std::move(theReq)))
                 theReq->fulfill(UV_ENOTSUP); // unless another request has already been issued
+            flushWrites(thePipe); // the writes queued so far go first, as if they had been issued at once
             thePipe->close();
         }
 
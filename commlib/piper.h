@@ -3,18 +3,114 @@
 #include "delegate.h"
 #include "wrappers.h"
 #include "request.h"
+#include "slotmap.h"
+#include "sharedpayload.h"
 #include <uv.h>
 #include <memory>
 #include <future>
 #include <thread>
-#include <mutex>
 #include <vector>
 #include <concepts>
-#include <unordered_map>
+#include <atomic>
+#include <optional>
+#include <memory_resource>
+#include <cstddef>
+#include <span>
 
 namespace uvcomms4
 {
 
+/** How the pipes collect incoming data (see PiperOptions::collector) */
+enum class ReadCollector
+{
+    List,        // Collector: a list of read buffers
+    Ring,        // RingCollector
+    MirroredRing // RingCollector over mirrored memory where the system allows
+};
+
+struct PiperOptions
+{
+    /** Number of IO threads, each running its own uv loop (clamped to [1, Piper::max_io_threads]).
+     *  With more than one, connections accepted by a listener are handed over to the IO threads
+     *  in turn and outgoing connections are spread likewise; delegate callbacks for different pipes
+     *  may then run concurrently.
+     *  On Windows, accepted connections always stay on the listener's IO thread.
+    */
+    std::size_t ioThreads { 1 };
+
+    /** Sender-side backpressure, per pipe: once the bytes queued for writing (ours plus libuv's)
+     *  exceed writeHighWatermark, the delegate gets onWriteBlocked(); once they drop to
+     *  writeLowWatermark or below, it gets onWritable(). 0 disables the watermarks.
+    */
+    std::size_t writeHighWatermark { 0 };
+    std::size_t writeLowWatermark { 0 };
+
+    /** With the high watermark exceeded, write requests fail with UV_EAGAIN instead of being queued
+    */
+    bool failWritesAboveHighWatermark { false };
+
+    /** Receive-side flow control, per pipe: when the delegate leaves messages in the Collector
+     *  and the buffered data exceeds this limit, reading from the pipe stops (the kernel's
+     *  socket buffer then holds back the sender) until resumeReading() is called.
+     *  0 disables the limit.
+    */
+    std::size_t readBufferLimit { 0 };
+
+    /** Receive buffers come from a per-IO-thread pool of 64 KB slabs, allocated in 2 MB arenas
+     *  on demand up to this many slabs; 0 (the default) disables the pool (buffers come from the heap).
+     *  The arenas are kept until the Piper is destroyed: each IO thread may retain up to
+     *  this many slabs, rounded up to whole arenas of 31 slabs (e.g. 256 slabs take 18 MB per IO thread).
+     *  With readBufferHugePages, the arenas are backed by huge pages if the system allows
+    */
+    std::size_t readBufferPoolSlabs { 0 };
+    bool readBufferHugePages { false };
+
+    /** Receive buffers follow the recent read sizes of each pipe (an exponentially weighted average)
+     *  down to this size, so that a pipe carrying small messages does not hold on to 64 KB blocks;
+     *  0 keeps them at the pipe's receive buffer size. Buffers up to half a slab come from the heap
+    */
+    std::size_t minReadBufferSize { 1024 };
+
+    /** Once a pipe's Collector holds this many buffers, filled to a quarter of the read buffer size
+     *  or less on average, the unread data is moved to a single block of its size (see Collector::compact());
+     *  0 disables
+    */
+    std::size_t compactBufferCount { 4 };
+
+    /** All the pipes of an IO thread read into a single buffer of that thread: complete messages are
+     *  delivered straight from it and only what is left over (a partial message, or messages the delegate
+     *  leaves for later) is copied to the pipe's Collector, so an idle pipe holds no receive buffer.
+     *  A buffer still referred to by MessageViews is replaced rather than reused.
+     *  Not with a Ring collector; directReadThreshold still applies
+    */
+    bool sharedReadBuffer { false };
+
+    /** With a Ring collector, each pipe reads straight into a buffer of its own
+     *  and the delegate gets onRingMessage() rather than onMessage(); the buffer pool is not used.
+     *  Only for a delegate that takes ring messages (see PiperDelegate::takesRingMessages())
+    */
+    ReadCollector collector { ReadCollector::List };
+
+    /** Once the header of a message has arrived and at least this many bytes of it are still to come,
+     *  the rest of it is read straight into a buffer of the message's final size
+     *  (see Collector::reserveMessage()); 0 disables. A Ring collector grows to the message size at once instead
+    */
+    std::size_t directReadThreshold { 256 * 1024 };
+
+    /** Messages of at least this many bytes are read straight into memory backed by a temporary file
+     *  (see map_spill()), which the system can page out, rather than into the heap; 0 disables.
+     *  Such a message is a single block: Collector::getMessageView() takes it in place (MessageView::spilled()).
+     *  Only with the List collector; streamingThreshold, if lower, takes precedence
+    */
+    std::size_t spillThreshold { 0 };
+
+    /** Messages of at least this many bytes are streamed to the delegate as they arrive
+     *  (see PiperDelegate::onMessageBegin()) rather than collected whole; 0 disables.
+     *  Only with the List collector
+    */
+    std::size_t streamingThreshold { 0 };
+};
+
 class Piper :
     requests::RequestHandler
 {
@@ -23,7 +119,12 @@ public:
     friend UVPipe;
     friend struct detail::cb<Piper>;
 
-    Piper(PiperDelegate::pointer aDelegate);
+    static constexpr std::size_t max_io_threads = 128;
+    static constexpr std::size_t max_write_buffers = 1024; // per uv_write; IOV_MAX on Linux
+    static constexpr std::size_t shared_read_buffer_size = 64 * 1024; // see PiperOptions::sharedReadBuffer
+    static constexpr std::size_t message_arena_size = 64 * 1024; // see messageResource(); grows as needed
+
+    Piper(PiperDelegate::pointer aDelegate, PiperOptions const & aOptions = {});
     ~Piper();
 
     Piper(Piper const &) = delete;
@@ -33,6 +134,8 @@ public:
      *  for incoming connection on it.
      *  Returns (via future<>) the descriptor + error code of the listening pipe.
      *  It is highly discouraged to call this variant from the IO thread (will deadlock)
+     *  N.B. the future<> overloads allocate a shared state per call; blocking callers
+     *  may prefer the callback overloads with a completion token (see completion.h)
     */
     std::future<std::tuple<Descriptor, int>> listen(std::string const &aListenAddress);
 
@@ -73,15 +176,101 @@ public:
         std::invocable<int> callback_t>
     void write(Descriptor aPipeDescriptor, container_t &&aContainer, callback_t &&aCallback);
 
+    /** Writes the containers as the parts of a single message, back to back
+     *  (e.g. a header, some metadata and the payload), without concatenating them:
+     *  each goes to the pipe from where it is. Otherwise, same as write() with a single container.
+     *  A std::span<const char> part borrows the data, which must then stay valid until the write completes
+    */
+    template<requests::MessageableContainer ...parts_t>
+        requires (sizeof...(parts_t) > 0)
+    std::future<int> write(Descriptor aPipeDescriptor, std::tuple<parts_t...> &&aParts);
+
+    template<requests::MessageableContainer ...parts_t,
+        std::invocable<int> callback_t>
+        requires (sizeof...(parts_t) > 0)
+    void write(Descriptor aPipeDescriptor, std::tuple<parts_t...> &&aParts, callback_t &&aCallback);
+
+    /** Writes aData to the pipe straight from where it is, e.g. a static table or a mapped file,
+     *  without copying it or taking it over: the memory must stay valid and unchanged until the write completes,
+     *  and is not touched after that. Otherwise, same as write()
+    */
+    std::future<int> writeBorrowed(Descriptor aPipeDescriptor, std::span<const char> aData);
+
+    template<std::invocable<int> callback_t>
+    void writeBorrowed(Descriptor aPipeDescriptor, std::span<const char> aData, callback_t &&aCallback);
+
+    /** Writes every message of the range to the pipe, in order, as a single request:
+     *  one post to the IO thread, one completion and, as far as the pipe allows, one writev().
+     *  A container (e.g. a vector of strings) is moved, or copied, into the request and kept until the write completes;
+     *  the messages of a view (e.g. views::transform) are collected into a vector before writeMany() returns.
+     *  Returns (via future<>) the UV result code once all the messages have been written;
+     *  there is no per-message status: if the write fails, it is not known which of the
+     *  messages the other side got. An empty range completes with 0
+    */
+    template<requests::MessageRange range_t>
+    std::future<int> writeMany(Descriptor aPipeDescriptor, range_t &&aMessages);
+
+    template<requests::MessageRange range_t,
+        std::invocable<int> callback_t>
+    void writeMany(Descriptor aPipeDescriptor, range_t &&aMessages, callback_t &&aCallback);
+
+    /** Writes the same payload to every pipe of aPipeDescriptors, e.g. to broadcast an update:
+     *  each pipe gets a reference to the payload rather than a copy, and each IO thread
+     *  gets a single request for all of its pipes.
+     *  Returns (via future<>) once the payload has been written to all of the pipes (or has failed to):
+     *  0 if every write succeeded, otherwise the UV result code of one of those that failed
+    */
+    std::future<int> writeFanout(std::span<const Descriptor> aPipeDescriptors, SharedPayload const & aPayload);
+
+    /// the callback is called on the IO thread that completes the last of the writes
+    template<std::invocable<int> callback_t>
+    void writeFanout(std::span<const Descriptor> aPipeDescriptors, SharedPayload const & aPayload, callback_t &&aCallback);
+
 
     std::future<int> close(Descriptor aPipeDescriptor);
 
     template<std::invocable<int> callback_t>
     void close(Descriptor aPipeDescriptor, callback_t &&aCallback);
 
+    /** Stops reading from the pipe until resumeReading() is called;
+     *  meanwhile, whatever the other side sends stays in the kernel's socket buffer
+    */
+    void pauseReading(Descriptor aPipeDescriptor);
+
+    /** Resumes reading from a pipe paused by pauseReading() or by PiperOptions::readBufferLimit.
+     *  The messages left in the Collector by onMessage() are delivered again first
+    */
+    void resumeReading(Descriptor aPipeDescriptor);
+
+    /// receive buffer pool hits and misses of all the IO threads so far; any thread
+    BufferPoolStats readBufferPoolStats() const noexcept;
+
+    /** Memory for the transient allocations of the delegate's callbacks for the pipe, e.g.
+     *  aCollector.getMessage<std::pmr::string>(piper->messageResource(aPipe)): allocating from it
+     *  is a pointer bump and all of it is released at once as the callback returns to the loop,
+     *  so nothing allocated from it may outlive the callback (in particular, it must not be written).
+     *  Each IO thread has its own; to be called on the IO thread that owns the pipe
+    */
+    std::pmr::memory_resource *messageResource(Descriptor aPipeDescriptor) noexcept;
+
 private:
+    // descriptors carry the index of the IO thread (shard) that owns the pipe
+    static constexpr unsigned shard_shift = 56;
+
+    Piper(PiperDelegate::pointer aDelegate, PiperOptions const & aOptions, std::size_t aShardIndex); // additional IO thread
+
+    static PiperOptions effectiveOptions(PiperDelegate const & aDelegate, PiperOptions const & aOptions);
+    static BufferPool::pointer makeReadBufferPool(PiperOptions const & aOptions);
+    void startIOThread();
     void threadFunction(std::promise<void> aInitPromise);
 
+    Piper & shard(std::size_t aIndex) noexcept;
+    Piper & shardOf(Descriptor aDescriptor) noexcept; // the shard that owns the descriptor
+    Piper & nextShard() noexcept; // round-robin
+
+    void postFanoutWrite(std::span<const Descriptor> aPipeDescriptors, SharedPayload const & aPayload,
+        std::shared_ptr<requests::FanoutCompletion> const & aCompletion); // split by shard
+
     void requestStop();
 
     void onAsync(uv_async_t *aAsync);
@@ -95,40 +284,103 @@ private:
     void requireIOThread();
     void requireNonIOThread();
 
-    Descriptor nextDescriptor();
+    Descriptor nextDescriptor(); // reserves a descriptor; released by pipeUnregister()
 
     void triggerAsync();
 
     void postRequest(requests::Request::pointer);
     void processPendingRequests(bool aAbort);
+    void dispatchDeferredRequests();
+    void leaveCallbacks(); // the outermost CallbackScope is about to return to the loop
+
+    /** Requests posted from the IO thread while a libuv callback is running bypass the queue;
+     *  they are dispatched right before the outermost callback returns to the loop.
+     *  So are the writes queued on the pipes meanwhile, each pipe's in a single uv_write
+    */
+    class CallbackScope
+    {
+    public:
+        explicit CallbackScope(Piper *aPiper) noexcept :
+            mPiper(aPiper)
+        {
+            ++mPiper->mCallbackDepth;
+        }
+
+        ~CallbackScope()
+        {
+            if(0 == --mPiper->mCallbackDepth)
+                mPiper->leaveCallbacks();
+        }
+
+        CallbackScope(CallbackScope const &) = delete;
+        CallbackScope & operator = (CallbackScope const &) = delete;
+
+    private:
+        Piper *mPiper;
+    };
 
     void handleListenRequest(requests::ListenRequest *) override;
     void handleConnectRequest(requests::ConnectRequest *) override;
     void handleWriteRequest(requests::WriteRequest *) override;
+    void handleFanoutWriteRequest(requests::FanoutWriteRequest *) override;
     void handleCloseRequest(requests::CloseRequest *) override;
+    void handleAdoptRequest(requests::AdoptRequest *) override;
+    void handleReadControlRequest(requests::ReadControlRequest *) override;
+
+    void handOverConnection(uv_stream_t *aServer, Descriptor aListener, Piper & aTarget);
+
+    void scheduleFlush(UVPipe *aPipe); // the pipe's write queue is flushed by leaveCallbacks()
+    void flushWrites(); // all the scheduled pipes
+    void deliverMessages(UVPipe *aPipe); // complete messages in the pipe's Collector to the delegate
+    CollectorStatus streamMessages(UVPipe *aPipe); // same, streaming the large ones (PiperOptions::streamingThreshold)
+    void updateReading(UVPipe *aPipe); // starts/stops reading according to the pipe's state
+    std::size_t readBufferSize(UVPipe *aPipe, std::size_t aSuggested); // for the pipe's next read into a ReadBuffer
+    char *lendSharedReadBuffer(); // nullptr if it cannot be lent
+    void compactCollector(UVPipe *aPipe); // if it holds many mostly empty buffers
+
+    void flushWrites(UVPipe *aPipe);
+    std::size_t outstandingBytes(UVPipe *aPipe); // queued for writing, ours and libuv's
+    void checkWritable(UVPipe *aPipe); // notifies the delegate once the pipe is below the low watermark
 
+    UVPipe *pipeCreate(); // a new pipe with a fresh descriptor; not registered yet
     void pipeRegister(UVPipe * aPipe);
     void pipeUnregister(Descriptor aDescriptor);
     UVPipe *pipeGet(Descriptor aDescriptor);
+    UVPipe **pipeSlot(Descriptor aDescriptor); // nullptr if the descriptor is stale or not ours
 
 
 private:
     PiperDelegate::pointer  mDelegate { nullptr };
+    PiperOptions            mOptions;
+    BufferPool::pointer     mReadBufferPool; // may be null; outlives the IO thread
     std::thread             mIOThread;
     std::thread::id         mIOThreadId {};
 
-    bool                    mStopFlag { false };
+    requests::RequestPool   mRequestPool; // requests handled by this IO thread; outlives them all
+
+    std::atomic<bool>       mStopFlag { false };
     uv_async_t              mAsyncTrigger {};
-    std::mutex              mMx;
+    std::atomic<bool>       mAsyncPending { false }; // uv_async_send() issued and onAsync not yet running
+
+    SlotMap<UVPipe*>        mPipes; // IO thread only; descriptor = shard index + slot key
 
-    Descriptor              mNextDescriptor { 1 }; // IO thread only
-    std::unordered_map      <Descriptor, UVPipe*> mPipes; // IO thread only
+    MPSCQueue<requests::Request> mPendingRequests; // owns the requests it holds
 
-    std::vector<requests::Request::pointer>  mPendingRequests;
-    std::vector<requests::Request::pointer>  mPendingRequestsTemporary; // quickly switch these two under lock
+    unsigned                mCallbackDepth { 0 }; // IO thread only
+    std::vector<requests::Request*> mDeferredRequests; // IO thread only; owns the requests it holds
+    std::vector<Descriptor> mFlushPending; // IO thread only; pipes with writes to flush
+    std::vector<uv_buf_t>   mWriteBuffers; // IO thread only; scratch for flushWrites()
+    std::optional<ReadBuffer> mSharedReadBuffer; // IO thread only; see PiperOptions::sharedReadBuffer
+    std::unique_ptr<std::byte[]> mMessageArena { new std::byte[message_arena_size] };
+    std::pmr::monotonic_buffer_resource mMessageResource { mMessageArena.get(), message_arena_size }; // IO thread only
+    bool                    mSharedReadBufferLent { false }; // between onAlloc and onRead
 
     uv_loop_t               *mRunningLoop { nullptr }; // only accessed on the IO thread
 
+    std::size_t             mShardIndex { 0 }; // 0 is the Piper the user has constructed
+    std::vector<std::unique_ptr<Piper>> mShards; // additional IO threads; only populated on shard 0
+    std::atomic<std::size_t> mNextShard { 0 };
+
 };
 
 //============================================================================================
@@ -143,7 +395,7 @@ inline std::future<std::tuple<Descriptor, int>> Piper::listen(std::string const
     auto ret_future = thePromise.get_future();
 
     postRequest(
-        requests::makeListenRequest(aListenAddress, requests::promisingCallback(std::move(thePromise)))
+        requests::makeListenRequest(mRequestPool, aListenAddress, requests::promisingCallback(std::move(thePromise)))
     );
 
     return ret_future;
@@ -154,7 +406,7 @@ template <std::invocable<std::tuple<Descriptor, int>> callback_t>
 inline void Piper::listen(std::string const &aListenAddress, callback_t &&aCallback)
 {
     postRequest(
-        requests::makeListenRequest(aListenAddress, std::forward<callback_t>(aCallback))
+        requests::makeListenRequest(mRequestPool, aListenAddress, std::forward<callback_t>(aCallback))
     );
 }
 
@@ -166,8 +418,9 @@ inline std::future<std::tuple<Descriptor, int>> Piper::connect(std::string const
     std::promise<std::tuple<Descriptor, int>> thePromise;
     auto ret_future = thePromise.get_future();
 
-    postRequest(
-        requests::makeConnectRequest(aConnectAddress, requests::promisingCallback(std::move(thePromise)))
+    Piper & target = nextShard();
+    target.postRequest(
+        requests::makeConnectRequest(target.mRequestPool, aConnectAddress, requests::promisingCallback(std::move(thePromise)))
     );
 
     return ret_future;
@@ -177,8 +430,9 @@ inline std::future<std::tuple<Descriptor, int>> Piper::connect(std::string const
 template <std::invocable<std::tuple<Descriptor, int>> callback_t>
 inline void Piper::connect(std::string const &aConnectAddress, callback_t &&aCallback)
 {
-    postRequest(
-        requests::makeConnectRequest(aConnectAddress, std::forward<callback_t>(aCallback))
+    Piper & target = nextShard();
+    target.postRequest(
+        requests::makeConnectRequest(target.mRequestPool, aConnectAddress, std::forward<callback_t>(aCallback))
     );
 }
 
@@ -189,8 +443,9 @@ inline std::future<int> Piper::write(Descriptor aPipeDescriptor, container_t &&a
     std::promise<int> thePromise;
     auto ret_future = thePromise.get_future();
 
-    postRequest(
-        requests::makeWriteRequest(aPipeDescriptor,
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(
+        requests::makeWriteRequest(target.mRequestPool, aPipeDescriptor,
             std::forward<container_t>(aContainer),
             requests::promisingCallback(std::move(thePromise)))
     );
@@ -201,22 +456,115 @@ inline std::future<int> Piper::write(Descriptor aPipeDescriptor, container_t &&a
 template <requests::MessageableContainer container_t, std::invocable<int> callback_t>
 inline void Piper::write(Descriptor aPipeDescriptor, container_t &&aContainer, callback_t &&aCallback)
 {
-    postRequest(
-        requests::makeWriteRequest(aPipeDescriptor,
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(
+        requests::makeWriteRequest(target.mRequestPool, aPipeDescriptor,
             std::forward<container_t>(aContainer),
             std::forward<callback_t>(aCallback)
         )
     );
 }
 
+template <requests::MessageableContainer ...parts_t>
+    requires (sizeof...(parts_t) > 0)
+inline std::future<int> Piper::write(Descriptor aPipeDescriptor, std::tuple<parts_t...> &&aParts)
+{
+    requireNonIOThread();
+    std::promise<int> thePromise;
+    auto ret_future = thePromise.get_future();
+
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(
+        requests::makeWriteRequest(target.mRequestPool, aPipeDescriptor,
+            std::move(aParts),
+            requests::promisingCallback(std::move(thePromise)))
+    );
+
+    return ret_future;
+}
+
+template <requests::MessageableContainer ...parts_t, std::invocable<int> callback_t>
+    requires (sizeof...(parts_t) > 0)
+inline void Piper::write(Descriptor aPipeDescriptor, std::tuple<parts_t...> &&aParts, callback_t &&aCallback)
+{
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(
+        requests::makeWriteRequest(target.mRequestPool, aPipeDescriptor,
+            std::move(aParts),
+            std::forward<callback_t>(aCallback)
+        )
+    );
+}
+
+inline std::future<int> Piper::writeBorrowed(Descriptor aPipeDescriptor, std::span<const char> aData)
+{
+    return write(aPipeDescriptor, std::move(aData)); // a span only refers to the data
+}
+
+template <std::invocable<int> callback_t>
+inline void Piper::writeBorrowed(Descriptor aPipeDescriptor, std::span<const char> aData, callback_t &&aCallback)
+{
+    write(aPipeDescriptor, std::move(aData), std::forward<callback_t>(aCallback));
+}
+
+template <requests::MessageRange range_t>
+inline std::future<int> Piper::writeMany(Descriptor aPipeDescriptor, range_t &&aMessages)
+{
+    requireNonIOThread();
+    std::promise<int> thePromise;
+    auto ret_future = thePromise.get_future();
+
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(
+        requests::makeBatchWriteRequest(target.mRequestPool, aPipeDescriptor,
+            std::forward<range_t>(aMessages),
+            requests::promisingCallback(std::move(thePromise)))
+    );
+
+    return ret_future;
+}
+
+template <requests::MessageRange range_t, std::invocable<int> callback_t>
+inline void Piper::writeMany(Descriptor aPipeDescriptor, range_t &&aMessages, callback_t &&aCallback)
+{
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(
+        requests::makeBatchWriteRequest(target.mRequestPool, aPipeDescriptor,
+            std::forward<range_t>(aMessages),
+            std::forward<callback_t>(aCallback)
+        )
+    );
+}
+
+inline std::future<int> Piper::writeFanout(std::span<const Descriptor> aPipeDescriptors, SharedPayload const & aPayload)
+{
+    requireNonIOThread();
+    std::promise<int> thePromise;
+    auto ret_future = thePromise.get_future();
+
+    postFanoutWrite(aPipeDescriptors, aPayload,
+        requests::makeFanoutCompletion(aPipeDescriptors.size(), requests::promisingCallback(std::move(thePromise))));
+
+    return ret_future;
+}
+
+template <std::invocable<int> callback_t>
+inline void Piper::writeFanout(std::span<const Descriptor> aPipeDescriptors, SharedPayload const & aPayload, callback_t &&aCallback)
+{
+    postFanoutWrite(aPipeDescriptors, aPayload,
+        requests::makeFanoutCompletion(aPipeDescriptors.size(), std::forward<callback_t>(aCallback)));
+}
+
 inline std::future<int> Piper::close(Descriptor aPipeDescriptor)
 {
     requireNonIOThread();
     std::promise<int> thePromise;
     auto ret_future = thePromise.get_future();
 
-    postRequest(
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(
         requests::makeCloseRequest(
+            target.mRequestPool,
             aPipeDescriptor,
             requests::promisingCallback(std::move(thePromise))
         )
@@ -228,10 +576,23 @@ inline std::future<int> Piper::close(Descriptor aPipeDescriptor)
 template <std::invocable<int> callback_t>
 inline void Piper::close(Descriptor aPipeDescriptor, callback_t &&aCallback)
 {
-    postRequest(
-        requests::makeCloseRequest(aPipeDescriptor,
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(
+        requests::makeCloseRequest(target.mRequestPool, aPipeDescriptor,
             std::forward<callback_t>(aCallback))
     );
 }
 
+inline void Piper::pauseReading(Descriptor aPipeDescriptor)
+{
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(requests::makeReadControlRequest(target.mRequestPool, aPipeDescriptor, true));
+}
+
+inline void Piper::resumeReading(Descriptor aPipeDescriptor)
+{
+    Piper & target = shardOf(aPipeDescriptor);
+    target.postRequest(requests::makeReadControlRequest(target.mRequestPool, aPipeDescriptor, false));
+}
+
 }
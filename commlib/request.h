@@ -2,12 +2,19 @@
 
 #include "commlib.h"
 #include "pack.h"
+#include "mpsc.h"
+#include "requestpool.h"
+#include "sharedpayload.h"
 #include <uv.h>
 #include <string>
 #include <memory>
 #include <future>
 #include <type_traits>
 #include <tuple>
+#include <span>
+#include <vector>
+#include <ranges>
+#include <atomic>
 
 namespace uvcomms4::requests
 {
@@ -16,7 +23,10 @@ namespace uvcomms4::requests
     struct ListenRequest;
     struct ConnectRequest;
     struct WriteRequest;
+    struct FanoutWriteRequest;
     struct CloseRequest;
+    struct AdoptRequest;
+    struct ReadControlRequest;
 
     struct RequestHandler
     {
@@ -24,11 +34,15 @@ namespace uvcomms4::requests
         virtual void handleListenRequest(ListenRequest *) = 0;
         virtual void handleConnectRequest(ConnectRequest *) = 0;
         virtual void handleWriteRequest(WriteRequest *) = 0;
+        virtual void handleFanoutWriteRequest(FanoutWriteRequest *) = 0;
         virtual void handleCloseRequest(CloseRequest *) = 0;
+        virtual void handleAdoptRequest(AdoptRequest *) = 0;
+        virtual void handleReadControlRequest(ReadControlRequest *) = 0;
     };
 
 
-    struct Request
+    /// MPSCNode is the link for Piper's submission queue
+    struct Request: MPSCNode
     {
         using pointer = std::unique_ptr<Request>;
         virtual ~Request() {}
@@ -36,6 +50,27 @@ namespace uvcomms4::requests
         virtual void dispatchToHandler(RequestHandler * aHandler) = 0;
 
         virtual void abort() = 0;
+
+        // Requests live either in a RequestPool or on the heap; operator delete can tell which
+        static void *operator new(std::size_t aSize)
+        {
+            return RequestPool::allocate(nullptr, aSize);
+        }
+
+        static void *operator new(std::size_t aSize, RequestPool & aPool)
+        {
+            return RequestPool::allocate(&aPool, aSize);
+        }
+
+        static void operator delete(void *aPtr) noexcept
+        {
+            RequestPool::deallocate(aPtr);
+        }
+
+        static void operator delete(void *aPtr, RequestPool &) noexcept
+        {
+            RequestPool::deallocate(aPtr);
+        }
     };
 
 
@@ -88,10 +123,10 @@ namespace uvcomms4::requests
 
     template<std::invocable<ListenRequest::retval_t> callback_t>
     inline std::unique_ptr<ListenRequest>
-    makeListenRequest(std::string const & aListenAddress, callback_t && aCallback)
+    makeListenRequest(RequestPool & aPool, std::string const & aListenAddress, callback_t && aCallback)
     {
-        return std::make_unique< ListenRequestImpl<std::decay_t<callback_t>>>
-            (aListenAddress, std::forward<callback_t>(aCallback));
+        return std::unique_ptr<ListenRequest>(new (aPool) ListenRequestImpl<std::decay_t<callback_t>>
+            (aListenAddress, std::forward<callback_t>(aCallback)));
     }
 
     template<typename retval_t>
@@ -160,10 +195,10 @@ namespace uvcomms4::requests
 
     template<std::invocable<ConnectRequest::retval_t> callback_t>
     inline std::unique_ptr<ConnectRequest>
-    makeConnectRequest(std::string const & aConnectAddress, callback_t && aCallback)
+    makeConnectRequest(RequestPool & aPool, std::string const & aConnectAddress, callback_t && aCallback)
     {
-        return std::make_unique< ConnectRequestImpl<std::decay_t<callback_t>>>
-            (aConnectAddress, std::forward<callback_t>(aCallback));
+        return std::unique_ptr<ConnectRequest>(new (aPool) ConnectRequestImpl<std::decay_t<callback_t>>
+            (aConnectAddress, std::forward<callback_t>(aCallback)));
     }
 
 
@@ -192,6 +227,32 @@ namespace uvcomms4::requests
     && detail::value_sizeof_1<T>()
     && std::is_nothrow_move_constructible_v<T>;
 
+    static_assert(MessageableContainer<SharedPayload>);
+
+    /// a range of messages, each a MessageableContainer (see Piper::writeMany())
+    template<typename range_t>
+    concept MessageRange = std::ranges::input_range<range_t>
+        && MessageableContainer<std::ranges::range_value_t<range_t>>;
+
+    namespace detail
+    {
+        template<typename T>
+        inline constexpr bool is_owning_view = false;
+
+        template<typename T>
+        inline constexpr bool is_owning_view<std::ranges::owning_view<T>> = true;
+
+        /** The messages can be framed where they are once the range has been moved into the request:
+         *  the range owns them (a container, not a view of someone else's) and yields references to them.
+         *  Otherwise (e.g. a transform_view that makes each message on the fly) they are collected into a vector first
+        */
+        template<typename range_t>
+        inline constexpr bool keeps_messages =
+            std::ranges::forward_range<range_t>
+            && std::is_lvalue_reference_v<std::ranges::range_reference_t<range_t>>
+            && (!std::ranges::view<range_t> || is_owning_view<range_t>);
+    }
+
 
     struct WriteRequest: Request
     {
@@ -199,8 +260,6 @@ namespace uvcomms4::requests
         static constexpr std::size_t header_size = 8;
 
         Descriptor pipeDescriptor { 0 };
-        char header[header_size] { 0 };
-        uv_write_t uv_write_request {};
 
         void dispatchToHandler(RequestHandler *aHandler) override
         {
@@ -214,28 +273,66 @@ namespace uvcomms4::requests
             fulfill(UV_ECANCELED);
         }
 
-        virtual char const * data() const noexcept = 0;
-        virtual std::size_t  size() const noexcept = 0;
+        /// what goes to the pipe, headers included: bufferCount() separate buffers, back to back
+        virtual std::size_t  bufferCount() const noexcept = 0;
+        virtual std::span<const char> buffer(std::size_t aIndex) const noexcept = 0;
+        virtual std::size_t  byteCount() const noexcept = 0; // of all the buffers
+
+        static void packHeader(std::size_t aMessageSize, char *aHeader) noexcept
+        {
+            u32_pack(static_cast<std::uint32_t>(aMessageSize), aHeader);
+            u32_pack(static_cast<std::uint32_t>(length_hash(aMessageSize)), &aHeader[4]);
+        }
 
     protected:
-        WriteRequest(Descriptor aPipeDescriptor, std::size_t aMessageSize):
+        explicit WriteRequest(Descriptor aPipeDescriptor):
             pipeDescriptor(aPipeDescriptor)
+        {}
+
+    };
+
+
+    /** A single message: the header, then the body in one or more parts
+    */
+    struct MessageWriteRequest: WriteRequest
+    {
+        char header[header_size] { 0 };
+
+        virtual std::size_t  partCount() const noexcept = 0;
+        virtual std::span<const char> part(std::size_t aIndex) const noexcept = 0;
+        virtual std::size_t  size() const noexcept = 0; // of all the parts
+
+        std::size_t bufferCount() const noexcept override
         {
-            uv_write_request.data = this;
-            u32_pack(static_cast<std::uint32_t>(aMessageSize), header);
-            u32_pack(static_cast<std::uint32_t>(length_hash(aMessageSize)), &header[4]);
+            return 1 + partCount();
         }
 
+        std::span<const char> buffer(std::size_t aIndex) const noexcept override
+        {
+            return aIndex == 0 ? std::span<const char>(header) : part(aIndex - 1);
+        }
+
+        std::size_t byteCount() const noexcept override
+        {
+            return header_size + size();
+        }
+
+    protected:
+        MessageWriteRequest(Descriptor aPipeDescriptor, std::size_t aMessageSize):
+            WriteRequest(aPipeDescriptor)
+        {
+            packHeader(aMessageSize, header);
+        }
     };
 
 
     template<typename container_t, typename callback_t>
-    struct WriteRequestImpl: WriteRequest
+    struct WriteRequestImpl: MessageWriteRequest
     {
         template<MessageableContainer cont_t,
             std::invocable<retval_t> fun_t>
         WriteRequestImpl(Descriptor aPipeDescriptor, cont_t &&aContainer, fun_t &&aCallback):
-            WriteRequest(aPipeDescriptor, std::size(aContainer)),
+            MessageWriteRequest(aPipeDescriptor, std::size(aContainer)),
             mContainer(std::forward<cont_t>(aContainer)),
             mCallback(std::forward<fun_t>(aCallback))
         {}
@@ -245,9 +342,14 @@ namespace uvcomms4::requests
             mCallback(aRetval);
         }
 
-        char const * data() const noexcept override
+        std::size_t partCount() const noexcept override
         {
-            return std::data(mContainer);
+            return 1;
+        }
+
+        std::span<const char> part(std::size_t) const noexcept override
+        {
+            return { reinterpret_cast<char const*>(std::data(mContainer)), std::size(mContainer) };
         }
 
         std::size_t  size() const noexcept override
@@ -260,15 +362,304 @@ namespace uvcomms4::requests
     };
 
 
+    /** A message made of several containers, written without concatenating them
+    */
+    template<typename parts_t, typename callback_t>
+    struct MultipartWriteRequestImpl: MessageWriteRequest
+    {
+        static constexpr std::size_t part_count = std::tuple_size_v<parts_t>;
+
+        template<typename tuple_t, std::invocable<retval_t> fun_t>
+        MultipartWriteRequestImpl(Descriptor aPipeDescriptor, tuple_t &&aParts, fun_t &&aCallback):
+            MessageWriteRequest(aPipeDescriptor, totalSize(aParts)),
+            mParts(std::forward<tuple_t>(aParts)),
+            mCallback(std::forward<fun_t>(aCallback))
+        {
+            // the containers have settled in the request
+            std::apply([this](auto const & ...aPart) {
+                std::size_t i = 0;
+                ((mSpans[i++] = { reinterpret_cast<char const*>(std::data(aPart)), std::size(aPart) }), ...);
+            }, mParts);
+        }
+
+        void fulfill(retval_t aRetval) override
+        {
+            mCallback(aRetval);
+        }
+
+        std::size_t partCount() const noexcept override
+        {
+            return part_count;
+        }
+
+        std::span<const char> part(std::size_t aIndex) const noexcept override
+        {
+            return mSpans[aIndex];
+        }
+
+        std::size_t  size() const noexcept override
+        {
+            return totalSize(mParts);
+        }
+
+        template<typename tuple_t>
+        static std::size_t totalSize(tuple_t const & aParts) noexcept
+        {
+            return std::apply([](auto const & ...aPart) { return (std::size_t(0) + ... + std::size(aPart)); }, aParts);
+        }
+
+        parts_t     mParts;
+        callback_t  mCallback;
+        std::span<const char> mSpans[part_count];
+    };
+
+
+    /** Many messages in one request, framed one after another; fulfilled once for all of them
+    */
+    template<typename range_t, typename callback_t>
+    struct BatchWriteRequestImpl: WriteRequest
+    {
+        template<typename messages_t, std::invocable<retval_t> fun_t>
+        BatchWriteRequestImpl(Descriptor aPipeDescriptor, messages_t &&aMessages, fun_t &&aCallback):
+            WriteRequest(aPipeDescriptor),
+            mMessages(std::forward<messages_t>(aMessages)),
+            mCallback(std::forward<fun_t>(aCallback))
+        {
+            // the messages have settled in the request (see detail::keeps_messages)
+            static_assert(detail::keeps_messages<range_t>);
+            if constexpr(std::ranges::sized_range<range_t>)
+                mFrames.reserve(std::ranges::size(mMessages));
+            for(auto const & message: mMessages)
+            {
+                Frame & frame = mFrames.emplace_back();
+                frame.body = { reinterpret_cast<char const*>(std::data(message)), std::size(message) };
+                packHeader(frame.body.size(), frame.header);
+                mByteCount += header_size + frame.body.size();
+            }
+        }
+
+        void fulfill(retval_t aRetval) override
+        {
+            mCallback(aRetval);
+        }
+
+        std::size_t bufferCount() const noexcept override
+        {
+            return 2 * mFrames.size();
+        }
+
+        std::span<const char> buffer(std::size_t aIndex) const noexcept override
+        {
+            Frame const & frame = mFrames[aIndex / 2];
+            return aIndex % 2 == 0 ? std::span<const char>(frame.header) : frame.body;
+        }
+
+        std::size_t byteCount() const noexcept override
+        {
+            return mByteCount;
+        }
+
+        struct Frame
+        {
+            char header[header_size];
+            std::span<const char> body;
+        };
+
+        range_t             mMessages;
+        callback_t          mCallback;
+        std::vector<Frame>  mFrames;
+        std::size_t         mByteCount { 0 };
+    };
+
+
     template<MessageableContainer container_t,
             std::invocable<WriteRequest::retval_t> callback_t>
     inline std::unique_ptr<WriteRequest>
-    makeWriteRequest(Descriptor aPipeDescriptor, container_t &&aContainer, callback_t &&aCallback)
+    makeWriteRequest(RequestPool & aPool, Descriptor aPipeDescriptor, container_t &&aContainer, callback_t &&aCallback)
     {
-        return std::make_unique<WriteRequestImpl<
+        return std::unique_ptr<WriteRequest>(new (aPool) WriteRequestImpl<
             std::decay_t<container_t>,
-            std::decay_t<callback_t>  >>
-            (aPipeDescriptor, std::forward<container_t>(aContainer), std::forward<callback_t>(aCallback));
+            std::decay_t<callback_t>  >
+            (aPipeDescriptor, std::forward<container_t>(aContainer), std::forward<callback_t>(aCallback)));
+    }
+
+
+    template<MessageableContainer ...parts_t,
+            std::invocable<WriteRequest::retval_t> callback_t>
+    inline std::unique_ptr<WriteRequest>
+    makeWriteRequest(RequestPool & aPool, Descriptor aPipeDescriptor, std::tuple<parts_t...> &&aParts, callback_t &&aCallback)
+    {
+        return std::unique_ptr<WriteRequest>(new (aPool) MultipartWriteRequestImpl<
+            std::tuple<std::decay_t<parts_t>...>,
+            std::decay_t<callback_t>  >
+            (aPipeDescriptor, std::move(aParts), std::forward<callback_t>(aCallback)));
+    }
+
+
+    template<MessageRange range_t,
+            std::invocable<WriteRequest::retval_t> callback_t>
+    inline std::unique_ptr<WriteRequest>
+    makeBatchWriteRequest(RequestPool & aPool, Descriptor aPipeDescriptor, range_t &&aMessages, callback_t &&aCallback)
+    {
+        if constexpr(detail::keeps_messages<std::decay_t<range_t>>)
+        {
+            return std::unique_ptr<WriteRequest>(new (aPool) BatchWriteRequestImpl<
+                std::decay_t<range_t>,
+                std::decay_t<callback_t>  >
+                (aPipeDescriptor, std::forward<range_t>(aMessages), std::forward<callback_t>(aCallback)));
+        }
+        else
+        {
+            // the messages would not outlive the iteration, or belong to the caller; take them over
+            std::vector<std::ranges::range_value_t<range_t>> messages;
+            if constexpr(std::ranges::sized_range<range_t>)
+                messages.reserve(std::ranges::size(aMessages));
+            for(auto && message: aMessages)
+                messages.emplace_back(std::forward<decltype(message)>(message));
+
+            return std::unique_ptr<WriteRequest>(new (aPool) BatchWriteRequestImpl<
+                decltype(messages),
+                std::decay_t<callback_t>  >
+                (aPipeDescriptor, std::move(messages), std::forward<callback_t>(aCallback)));
+        }
+    }
+
+
+//====================================================================================================
+// FanoutWriteRequest
+//====================================================================================================
+
+    /** The outcome of a fan-out write, shared by the writes to each of its pipes (possibly on
+     *  different IO threads): finish() is called once, with 0 or the first failure, when the last one completes
+    */
+    struct FanoutCompletion
+    {
+        explicit FanoutCompletion(std::size_t aPipeCount) noexcept:
+            mRemaining(aPipeCount)
+        {}
+
+        virtual ~FanoutCompletion() {}
+
+        /// the write to one of the pipes has completed
+        void complete(int aStatus) noexcept
+        {
+            int expected = 0;
+            if(aStatus != 0)
+                mStatus.compare_exchange_strong(expected, aStatus, std::memory_order_relaxed);
+            if(mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                finish(mStatus.load(std::memory_order_relaxed));
+        }
+
+        virtual void finish(int aStatus) = 0;
+
+    private:
+        std::atomic<std::size_t>    mRemaining;
+        std::atomic<int>            mStatus { 0 };
+    };
+
+    template<typename callback_t>
+    struct FanoutCompletionImpl: FanoutCompletion
+    {
+        template<typename fun_t>
+        FanoutCompletionImpl(std::size_t aPipeCount, fun_t && aCallback):
+            FanoutCompletion(aPipeCount),
+            mCallback(std::forward<fun_t>(aCallback))
+        {}
+
+        void finish(int aStatus) override
+        {
+            mCallback(aStatus);
+        }
+
+        callback_t mCallback;
+    };
+
+    template<std::invocable<int> callback_t>
+    inline std::shared_ptr<FanoutCompletion>
+    makeFanoutCompletion(std::size_t aPipeCount, callback_t &&aCallback)
+    {
+        return std::make_shared<FanoutCompletionImpl<std::decay_t<callback_t>>>(aPipeCount, std::forward<callback_t>(aCallback));
+    }
+
+
+    /** The payload queued on one of the pipes of a fan-out; goes out with the payload's own header
+    */
+    struct PayloadWriteRequest: WriteRequest
+    {
+        PayloadWriteRequest(Descriptor aPipeDescriptor, SharedPayload const & aPayload, std::shared_ptr<FanoutCompletion> const & aCompletion):
+            WriteRequest(aPipeDescriptor),
+            payload(aPayload),
+            completion(aCompletion)
+        {}
+
+        void fulfill(retval_t aRetval) override
+        {
+            payload = {}; // no longer needed by the time anyone hears of the outcome
+            completion->complete(aRetval);
+        }
+
+        std::size_t bufferCount() const noexcept override
+        {
+            return 2;
+        }
+
+        std::span<const char> buffer(std::size_t aIndex) const noexcept override
+        {
+            return aIndex == 0 ? std::span<const char>(payload.header()) : std::span<const char>(payload.data(), payload.size());
+        }
+
+        std::size_t byteCount() const noexcept override
+        {
+            return header_size + payload.size();
+        }
+
+        SharedPayload                       payload;
+        std::shared_ptr<FanoutCompletion>   completion;
+    };
+
+    inline std::unique_ptr<WriteRequest>
+    makePayloadWriteRequest(RequestPool & aPool, Descriptor aPipeDescriptor, SharedPayload const & aPayload,
+        std::shared_ptr<FanoutCompletion> const & aCompletion)
+    {
+        return std::unique_ptr<WriteRequest>(new (aPool) PayloadWriteRequest(aPipeDescriptor, aPayload, aCompletion));
+    }
+
+
+    /** Writes the same payload to the pipes of one IO thread: a PayloadWriteRequest is queued on each.
+     *  No descriptors at all is an empty fan-out, which completes at once
+    */
+    struct FanoutWriteRequest: Request
+    {
+        FanoutWriteRequest(std::vector<Descriptor> && aDescriptors, SharedPayload const & aPayload,
+            std::shared_ptr<FanoutCompletion> const & aCompletion):
+            descriptors(std::move(aDescriptors)),
+            payload(aPayload),
+            completion(aCompletion)
+        {}
+
+        void dispatchToHandler(RequestHandler *aHandler) override
+        {
+            aHandler->handleFanoutWriteRequest(this);
+        }
+
+        void abort() override
+        {
+            if(descriptors.empty())
+                completion->finish(UV_ECANCELED);
+            for(std::size_t i = 0; i < descriptors.size(); i++)
+                completion->complete(UV_ECANCELED);
+        }
+
+        std::vector<Descriptor>             descriptors;
+        SharedPayload                       payload;
+        std::shared_ptr<FanoutCompletion>   completion;
+    };
+
+    inline std::unique_ptr<FanoutWriteRequest>
+    makeFanoutWriteRequest(RequestPool & aPool, std::vector<Descriptor> && aDescriptors, SharedPayload const & aPayload,
+        std::shared_ptr<FanoutCompletion> const & aCompletion)
+    {
+        return std::unique_ptr<FanoutWriteRequest>(new (aPool) FanoutWriteRequest(std::move(aDescriptors), aPayload, aCompletion));
     }
 
 
@@ -318,11 +709,80 @@ namespace uvcomms4::requests
 
     template<std::invocable<CloseRequest::retval_t> callback_t>
     inline std::unique_ptr<CloseRequest>
-    makeCloseRequest(Descriptor aDescriptor, callback_t &&aCallback)
+    makeCloseRequest(RequestPool & aPool, Descriptor aDescriptor, callback_t &&aCallback)
     {
-        return std::make_unique<CloseRequestImpl<std::decay_t<callback_t>>>
-            (aDescriptor, std::forward<callback_t>(aCallback));
+        return std::unique_ptr<CloseRequest>(new (aPool) CloseRequestImpl<std::decay_t<callback_t>>
+            (aDescriptor, std::forward<callback_t>(aCallback)));
     }
 
 
+//====================================================================================================
+// AdoptRequest
+//====================================================================================================
+
+    /** Hands an accepted connection (as a file descriptor) over to another IO thread;
+     *  only issued by Piper itself. Owns the descriptor until the handler takes it.
+    */
+    struct AdoptRequest: Request
+    {
+        Descriptor  listener { 0 };
+        int         fd { -1 };
+
+        AdoptRequest(Descriptor aListener, int aFd) :
+            listener(aListener), fd(aFd)
+        {}
+
+        ~AdoptRequest()
+        {
+            if(fd >= 0)
+                close_fd(fd);
+        }
+
+        void dispatchToHandler(RequestHandler *aHandler) override
+        {
+            aHandler->handleAdoptRequest(this);
+        }
+
+        void abort() override
+        {} // nobody is waiting for this one; the descriptor is closed in destructor
+    };
+
+    inline std::unique_ptr<AdoptRequest>
+    makeAdoptRequest(Descriptor aListener, int aFd)
+    {
+        return std::make_unique<AdoptRequest>(aListener, aFd);
+    }
+
+
+
+//====================================================================================================
+// ReadControlRequest
+//====================================================================================================
+
+    /** Pauses or resumes reading from a pipe; nobody waits for the outcome
+    */
+    struct ReadControlRequest: Request
+    {
+        Descriptor  descriptor { 0 };
+        bool        pause { false };
+
+        ReadControlRequest(Descriptor aDescriptor, bool aPause) :
+            descriptor(aDescriptor), pause(aPause)
+        {}
+
+        void dispatchToHandler(RequestHandler *aHandler) override
+        {
+            aHandler->handleReadControlRequest(this);
+        }
+
+        void abort() override
+        {}
+    };
+
+    inline std::unique_ptr<ReadControlRequest>
+    makeReadControlRequest(RequestPool & aPool, Descriptor aDescriptor, bool aPause)
+    {
+        return std::unique_ptr<ReadControlRequest>(new (aPool) ReadControlRequest(aDescriptor, aPause));
+    }
+
 }
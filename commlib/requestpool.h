@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <iterator>
+
+namespace uvcomms4::requests
+{
+    /** Recycles memory for Request objects; Piper keeps one per IO thread.
+     *  Blocks come in a few size classes, each with a lock-free free list (an index-based
+     *  Treiber stack with an ABA tag), so that requests can be allocated on any thread
+     *  while they are normally released on the IO thread once fulfilled.
+     *  Blocks are carved from chunks allocated on demand, up to max_chunks per class;
+     *  objects too large for the largest class, and allocations beyond the limit,
+     *  go to the global heap. Every block is prefixed with a header that tells deallocate()
+     *  where the block came from.
+    */
+    class RequestPool
+    {
+    public:
+        static constexpr std::size_t size_classes[] = { 64, 128, 256, 512 };
+        static constexpr std::size_t blocks_per_chunk = 64;
+        static constexpr std::size_t max_chunks = 64; // per size class
+
+        RequestPool() = default;
+        ~RequestPool();
+
+        RequestPool(RequestPool const &) = delete;
+        RequestPool & operator = (RequestPool const &) = delete;
+
+        /// memory for an object of aSize bytes; from aPool if possible (aPool may be null)
+        static void *allocate(RequestPool *aPool, std::size_t aSize);
+
+        /// releases memory obtained from allocate(), whichever pool (if any) it came from; any thread
+        static void deallocate(void *aPtr) noexcept;
+
+    private:
+        static constexpr std::size_t class_count = std::size(size_classes);
+
+        struct alignas(16) BlockHeader
+        {
+            RequestPool                *pool { nullptr }; // null for heap blocks
+            std::uint32_t               handle { 0 }; // size class << 24 | block index
+            std::atomic<std::uint32_t>  next { 0 }; // next free block index + 1; 0 terminates
+        };
+
+        static constexpr std::size_t stride(std::size_t aClass) noexcept
+        {
+            return sizeof(BlockHeader) + size_classes[aClass];
+        }
+
+        BlockHeader *header(std::size_t aClass, std::uint32_t aIndex) const noexcept;
+        BlockHeader *pop(std::size_t aClass) noexcept;
+        void push(BlockHeader *aBlock) noexcept;
+        BlockHeader *grow(std::size_t aClass);
+
+    private:
+        std::atomic<std::uint64_t>  mFree[class_count] {}; // ABA tag << 32 | (top index + 1)
+        std::atomic<std::byte*>     mChunks[class_count][max_chunks] {};
+        std::atomic<std::size_t>    mChunkCount[class_count] {};
+    };
+
+
+    inline RequestPool::~RequestPool()
+    {
+        for(auto & chunks: mChunks)
+            for(auto & chunk: chunks)
+                if(std::byte *p = chunk.load())
+                    ::operator delete(p, std::align_val_t{alignof(BlockHeader)});
+    }
+
+    inline void *RequestPool::allocate(RequestPool *aPool, std::size_t aSize)
+    {
+        if(aPool)
+        {
+            for(std::size_t cls = 0; cls < class_count; cls++)
+            {
+                if(aSize > size_classes[cls])
+                    continue;
+
+                BlockHeader *block = aPool->pop(cls);
+                if(!block)
+                    block = aPool->grow(cls);
+                if(block)
+                    return block + 1;
+                break;
+            }
+        }
+
+        static_assert(sizeof(BlockHeader) % alignof(std::max_align_t) == 0);
+        auto block = new (::operator new(sizeof(BlockHeader) + aSize)) BlockHeader;
+        return block + 1;
+    }
+
+    inline void RequestPool::deallocate(void *aPtr) noexcept
+    {
+        if(!aPtr)
+            return;
+
+        BlockHeader *block = static_cast<BlockHeader*>(aPtr) - 1;
+        if(block->pool)
+            block->pool->push(block);
+        else
+        {
+            block->~BlockHeader();
+            ::operator delete(block);
+        }
+    }
+
+    inline RequestPool::BlockHeader *RequestPool::header(std::size_t aClass, std::uint32_t aIndex) const noexcept
+    {
+        std::byte *chunk = mChunks[aClass][aIndex / blocks_per_chunk].load(std::memory_order_acquire);
+        return reinterpret_cast<BlockHeader*>(chunk + (aIndex % blocks_per_chunk) * stride(aClass));
+    }
+
+    inline RequestPool::BlockHeader *RequestPool::pop(std::size_t aClass) noexcept
+    {
+        std::uint64_t head = mFree[aClass].load(std::memory_order_acquire);
+        while(auto top = static_cast<std::uint32_t>(head))
+        {
+            BlockHeader *block = header(aClass, top - 1);
+            // the block may be popped and reused by another thread meanwhile; then the tag changes and CAS fails
+            std::uint64_t next = ((head >> 32) + 1) << 32 | block->next.load(std::memory_order_relaxed);
+            if(mFree[aClass].compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+                return block;
+        }
+        return nullptr;
+    }
+
+    inline void RequestPool::push(BlockHeader *aBlock) noexcept
+    {
+        std::size_t cls = aBlock->handle >> 24;
+        std::uint32_t index = aBlock->handle & 0xFFFFFFu;
+
+        std::uint64_t head = mFree[cls].load(std::memory_order_relaxed);
+        std::uint64_t top;
+        do {
+            aBlock->next.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+            top = ((head >> 32) + 1) << 32 | (index + 1);
+        } while(!mFree[cls].compare_exchange_weak(head, top, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    inline RequestPool::BlockHeader *RequestPool::grow(std::size_t aClass)
+    {
+        if(mChunkCount[aClass].load(std::memory_order_relaxed) >= max_chunks)
+            return nullptr;
+
+        std::size_t chunkIndex = mChunkCount[aClass].fetch_add(1, std::memory_order_relaxed);
+        if(chunkIndex >= max_chunks)
+            return nullptr; // another thread has taken the last one
+
+        auto chunk = static_cast<std::byte*>(::operator new(stride(aClass) * blocks_per_chunk,
+            std::align_val_t{alignof(BlockHeader)}));
+
+        auto firstIndex = static_cast<std::uint32_t>(chunkIndex * blocks_per_chunk);
+        for(std::size_t i = 0; i < blocks_per_chunk; i++)
+        {
+            auto block = new (chunk + i * stride(aClass)) BlockHeader;
+            block->pool = this;
+            block->handle = static_cast<std::uint32_t>(aClass << 24) | (firstIndex + static_cast<std::uint32_t>(i));
+        }
+
+        // blocks must be reachable by index before they can be popped by other threads
+        mChunks[aClass][chunkIndex].store(chunk, std::memory_order_release);
+
+        for(std::size_t i = 1; i < blocks_per_chunk; i++)
+            push(reinterpret_cast<BlockHeader*>(chunk + i * stride(aClass)));
+
+        return reinterpret_cast<BlockHeader*>(chunk);
+    }
+
+}
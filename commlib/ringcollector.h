@@ -0,0 +1,346 @@
+#pragma once
+
+#include "commlib.h"
+#include "pack.h"
+#include "collector.h"
+#include <span>
+#include <tuple>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+namespace uvcomms4
+{
+
+    /** An alternative to Collector (see PiperOptions::collector): a single power-of-two buffer
+     *  the pipe reads into directly, so there is no allocation per read and every message is contiguous.
+     *  Where the system allows (see map_mirrored()), a mirrored buffer is used as a ring that never wraps;
+     *  otherwise the unread data is moved to the front when the free space behind it runs short.
+     *  The buffer grows to fit the largest message and keeps its size.
+     *
+     *  Messages are taken in place with peekMessage() + popMessage() or copied out with getMessage();
+     *  there is no getMessageView() since the memory is reused.
+    */
+    class RingCollector
+    {
+    public:
+        static constexpr std::size_t header_size = 8;
+        static constexpr std::size_t min_capacity = 64 * 1024;
+
+        explicit RingCollector(bool aMirrored = false) noexcept :
+            mMirrored(aMirrored)
+        {}
+
+        ~RingCollector()
+        {
+            release(mData, mCapacity, mIsMirror);
+        }
+
+        RingCollector(RingCollector const &) = delete;
+        RingCollector & operator = (RingCollector const &) = delete;
+
+        /** The free space to read into, at least aMinSize bytes (the buffer is compacted or grown as necessary);
+         *  empty if the memory could not be obtained
+        */
+        std::span<char> writable(std::size_t aMinSize = min_capacity / 2) noexcept;
+
+        /// aCount bytes have been written to the front of writable()
+        void commit(std::size_t aCount) noexcept
+        {
+            mSize += aCount;
+        }
+
+        /// check if there's at least aSize bytes available ahead of the current position
+        bool contains(std::size_t aSize) const noexcept
+        {
+            return aSize <= mSize;
+        }
+
+        /// number of bytes ahead of the current position
+        std::size_t bufferedBytes() const noexcept
+        {
+            return mSize;
+        }
+
+        /// same as Collector::expectedRemaining()
+        std::size_t expectedRemaining() noexcept
+        {
+            auto msglen = messageLength(false);
+            if(msglen < 0)
+                return 0;
+            std::size_t frame = header_size + std::size_t(msglen);
+            return frame > mSize ? frame - mSize : 0;
+        }
+
+        std::size_t capacity() const noexcept
+        {
+            return mCapacity;
+        }
+
+        /// the buffer is mirrored (may differ from what was asked for if the system does not allow)
+        bool mirrored() const noexcept
+        {
+            return mIsMirror;
+        }
+
+        /// same as Collector::messageLength()
+        std::ptrdiff_t messageLength(bool aAdvance = false) noexcept;
+
+        /// returns the current Collector status (has message/no message/corrupt)
+        CollectorStatus status() noexcept;
+
+        /** The body of the current message, in place; valid until the Collector is modified
+         *  (the next popMessage() or read)
+        */
+        std::tuple<CollectorStatus, std::span<const char>> peekMessage() noexcept;
+
+        /// drops the current message if it's complete
+        void popMessage() noexcept;
+
+        /** extracts the current message to the supplied iterator or conainer
+         * (whichever type copyTo() supports)
+        */
+        template<typename dest_t>
+        CollectorStatus extractMessageTo(dest_t && aDest);
+
+        /** Get the current message if exists */
+        template<typename container_t>
+        std::tuple<CollectorStatus, container_t> getMessage();
+
+        /// same as Collector::getMessage(aAllocator)
+        template<typename container_t, typename allocator_t>
+            requires std::constructible_from<container_t, allocator_t const &>
+        std::tuple<CollectorStatus, container_t> getMessage(allocator_t const & aAllocator);
+
+        /// same as Collector::copyTo()
+        template<std::output_iterator<char> iter_t>
+        bool copyTo(iter_t aDest, std::size_t aCount, bool aAdvance);
+
+        /// same as Collector::copyTo()
+        template<typename container_t>
+            requires requires(container_t cont, char c) { { cont.push_back(c) };  }
+        bool copyTo(container_t & aContainer, std::size_t aCount, bool aAdvance);
+
+    private:
+        char const *head() const noexcept
+        {
+            return mData + mHead;
+        }
+
+        void skip(std::size_t aCount) noexcept;
+        bool reserve(std::size_t aFree) noexcept;
+        static void release(char *aData, std::size_t aCapacity, bool aMirror) noexcept;
+
+    private:
+        char           *mData { nullptr };
+        std::size_t     mCapacity { 0 };
+        std::size_t     mHead { 0 };  // < mCapacity; the data is at [mHead, mHead + mSize)
+        std::size_t     mSize { 0 };
+        std::ptrdiff_t  mFrameLength { MORE_DATA }; // the decoded header at mHead, if it's been decoded
+        bool            mMirrored;    // requested
+        bool            mIsMirror { false };
+    };
+
+
+    inline std::span<char> RingCollector::writable(std::size_t aMinSize) noexcept
+    {
+        if(mSize == 0)
+            mHead = 0;
+
+        if(!reserve(aMinSize))
+            return {};
+
+        char *tail = mData + mHead + mSize; // the mirror half is still the same buffer
+        return { tail, mIsMirror ? mCapacity - mSize : mCapacity - mHead - mSize };
+    }
+
+
+    inline bool RingCollector::reserve(std::size_t aFree) noexcept
+    {
+        std::size_t needed = mSize + aFree;
+        if(needed <= mCapacity && (mIsMirror || mHead + needed <= mCapacity))
+            return true;
+
+        if(needed <= mCapacity) // only a linear buffer gets here
+        {
+            std::memmove(mData, mData + mHead, mSize);
+            mHead = 0;
+            return true;
+        }
+
+        std::size_t capacity = std::max(mCapacity, min_capacity);
+        while(capacity < needed)
+            capacity *= 2;
+
+        char *data = nullptr;
+        bool mirror = false;
+        if(mMirrored)
+        {
+            data = static_cast<char*>(map_mirrored(capacity));
+            mirror = (data != nullptr);
+        }
+        if(!data)
+            data = static_cast<char*>(allocate_pages(capacity, false));
+        if(!data)
+            return false;
+
+        if(mSize > 0)
+            std::memcpy(data, mData + mHead, mSize);
+        release(mData, mCapacity, mIsMirror);
+
+        mData = data;
+        mCapacity = capacity;
+        mHead = 0;
+        mIsMirror = mirror;
+        return true;
+    }
+
+
+    inline void RingCollector::release(char *aData, std::size_t aCapacity, bool aMirror) noexcept
+    {
+        if(aMirror)
+            unmap_mirrored(aData, aCapacity);
+        else
+            free_pages(aData, aCapacity);
+    }
+
+
+    inline void RingCollector::skip(std::size_t aCount) noexcept
+    {
+        mHead += aCount;
+        mSize -= aCount;
+        if(mIsMirror && mHead >= mCapacity)
+            mHead -= mCapacity;
+        mFrameLength = MORE_DATA;
+    }
+
+
+    inline std::ptrdiff_t RingCollector::messageLength(bool aAdvance) noexcept
+    {
+        if(mFrameLength == MORE_DATA)
+        {
+            if(mSize < header_size)
+                return MORE_DATA;
+
+            std::uint32_t length = u32_unpack(head());
+            std::uint32_t lenhash = u32_unpack(head() + 4);
+            mFrameLength = length_hash(length) == lenhash ? std::ptrdiff_t(length) : DATA_CORRUPT;
+        }
+
+        auto length = mFrameLength;
+        if(aAdvance && length >= 0)
+            skip(header_size);
+        return length;
+    }
+
+
+    inline CollectorStatus RingCollector::status() noexcept
+    {
+        auto msglen = messageLength(false);
+        switch(msglen)
+        {
+        case MORE_DATA:
+            return CollectorStatus::NoMessage;
+        case DATA_CORRUPT:
+            return CollectorStatus::Corrupt;
+        default:
+            return contains(std::size_t(msglen) + header_size) ? CollectorStatus::HasMessage : CollectorStatus::NoMessage;
+        };
+    }
+
+
+    inline std::tuple<CollectorStatus, std::span<const char>> RingCollector::peekMessage() noexcept
+    {
+        if(CollectorStatus st = status(); st != CollectorStatus::HasMessage)
+            return { st, {} };
+
+        return { CollectorStatus::HasMessage, { head() + header_size, std::size_t(mFrameLength) } };
+    }
+
+
+    inline void RingCollector::popMessage() noexcept
+    {
+        if(status() == CollectorStatus::HasMessage)
+            skip(header_size + std::size_t(mFrameLength));
+    }
+
+
+    template <typename dest_t>
+    inline CollectorStatus RingCollector::extractMessageTo(dest_t &&aDest)
+    {
+        if(auto st = status(); st != CollectorStatus::HasMessage)
+            return st;
+
+        auto size = messageLength(true);
+        return copyTo(aDest, size, true) ? CollectorStatus::HasMessage : CollectorStatus::Corrupt;
+    }
+
+
+    template <typename container_t>
+    inline std::tuple<CollectorStatus, container_t> RingCollector::getMessage()
+    {
+        if(CollectorStatus st = status(); st == CollectorStatus::HasMessage)
+        {
+            container_t container;
+            extractMessageTo(container);
+            return { st, std::move(container) };
+        }
+        else
+            return { st, {} };
+    }
+
+
+    template <typename container_t, typename allocator_t>
+        requires std::constructible_from<container_t, allocator_t const &>
+    inline std::tuple<CollectorStatus, container_t> RingCollector::getMessage(allocator_t const &aAllocator)
+    {
+        container_t container(aAllocator);
+        CollectorStatus st = extractMessageTo(container);
+        return { st, std::move(container) };
+    }
+
+
+    template <std::output_iterator<char> iter_t>
+    inline bool RingCollector::copyTo(iter_t aDest, std::size_t aCount, bool aAdvance)
+    {
+        std::size_t available = std::min(aCount, mSize);
+        if constexpr(std::is_same_v<iter_t, char*>)
+            bulk_copy(aDest, head(), available, available >= nontemporal_copy_threshold);
+        else
+            std::copy(head(), head() + available, aDest);
+        if(available < aCount)
+            return false;
+
+        if(aAdvance)
+            skip(aCount);
+        return true;
+    }
+
+
+    template <typename container_t>
+        requires requires(container_t cont, char c) { { cont.push_back(c) };  }
+    inline bool RingCollector::copyTo(container_t &aContainer, std::size_t aCount, bool aAdvance)
+    {
+        if constexpr(ContiguousByteContainer<container_t>)
+        {
+            std::size_t available = std::min(aCount, mSize);
+            std::size_t size = aContainer.size();
+            aContainer.resize(size + available);
+            char *dest = reinterpret_cast<char*>(aContainer.data()) + size;
+            copyTo(dest, available, aAdvance && available == aCount);
+            return available == aCount;
+        }
+        else
+        {
+            if constexpr(requires (container_t cont, std::size_t sz) {
+                { cont.size() } -> std::convertible_to<std::size_t>;
+                { cont.reserve(sz) };
+            })
+            {
+                aContainer.reserve(aContainer.size() + aCount);
+            }
+            return copyTo(std::back_inserter(aContainer), aCount, aAdvance);
+        }
+    }
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "pack.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace uvcomms4
+{
+
+    /** An immutable message body shared by reference: copies only bump a reference count,
+     *  so the same payload can be queued on any number of pipes (see Piper::writeFanout())
+     *  or kept for later without copying the data. The header is computed once, up front.
+     *  Satisfies requests::MessageableContainer, so it can also be passed to Piper::write().
+     *  The data is released with the last copy; the copies may live on different threads
+    */
+    class SharedPayload
+    {
+    public:
+        static constexpr std::size_t header_size = 8;
+
+        SharedPayload() = default;
+
+        /// takes over (if moved in) or copies the container, e.g. a std::string or std::vector<char>
+        template<typename container_t>
+            requires requires (container_t const & c) {
+                { std::data(c) };
+                { std::size(c) } -> std::convertible_to<std::size_t>;
+            } && (sizeof(*std::data(std::declval<container_t const &>())) == 1)
+              && (!std::is_same_v<std::remove_cvref_t<container_t>, SharedPayload>)
+        explicit SharedPayload(container_t && aContainer):
+            mBlock(std::make_shared<Holder<std::remove_cvref_t<container_t>>>(std::forward<container_t>(aContainer)))
+        {}
+
+        char const *data() const noexcept
+        {
+            return mBlock ? mBlock->data : nullptr;
+        }
+
+        std::size_t size() const noexcept
+        {
+            return mBlock ? mBlock->size : 0;
+        }
+
+        char const *begin() const noexcept
+        {
+            return data();
+        }
+
+        char const *end() const noexcept
+        {
+            return data() + size();
+        }
+
+        /// the header that precedes the body on the wire
+        std::span<const char, header_size> header() const noexcept
+        {
+            return std::span<const char, header_size>(mBlock ? mBlock->header : empty_header.header, header_size);
+        }
+
+        /// number of SharedPayload objects referring to the same data (0 if none)
+        long useCount() const noexcept
+        {
+            return mBlock.use_count();
+        }
+
+    private:
+        struct Block
+        {
+            virtual ~Block() = default;
+
+            void seal(char const *aData, std::size_t aSize) noexcept
+            {
+                data = aData;
+                size = aSize;
+                u32_pack(static_cast<std::uint32_t>(aSize), header);
+                u32_pack(length_hash(static_cast<std::uint32_t>(aSize)), &header[4]);
+            }
+
+            char            header[header_size] { 0 };
+            char const     *data { nullptr };
+            std::size_t     size { 0 };
+        };
+
+        template<typename container_t>
+        struct Holder final: Block
+        {
+            template<typename arg_t>
+            explicit Holder(arg_t && aContainer):
+                container(std::forward<arg_t>(aContainer))
+            {
+                seal(reinterpret_cast<char const*>(std::data(container)), std::size(container));
+            }
+
+            container_t container;
+        };
+
+        struct EmptyHeader: Block
+        {
+            EmptyHeader() noexcept { seal(nullptr, 0); }
+        };
+
+        static inline EmptyHeader const empty_header;
+
+        std::shared_ptr<Block const> mBlock;
+    };
+
+}
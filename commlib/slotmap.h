@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <cassert>
+
+namespace uvcomms4
+{
+    /** A dense table of values addressed by generation-checked keys.
+     *  A key consists of the slot index (lower 24 bits) and the generation of the slot
+     *  (next 32 bits), so it always fits in 56 bits and is never 0.
+     *  Erased slots are reused (least recently freed first, so that churn goes round all of them)
+     *  with the generation bumped, so a stale key does not match the slot's new occupant
+     *  until the generation wraps; lookup is a bounds check plus a generation compare.
+     *  The table only grows up to the maximum number of simultaneously live values.
+    */
+    template<typename value_t>
+    class SlotMap
+    {
+    public:
+        using key_t = std::uint64_t;
+
+        static constexpr unsigned index_bits = 24;
+        static constexpr unsigned generation_bits = 32;
+        static constexpr key_t key_mask = (key_t{1} << (index_bits + generation_bits)) - 1;
+
+        /// occupies a slot and returns its key
+        key_t insert(value_t aValue)
+        {
+            std::uint32_t index;
+            if(mFreeHead != no_slot)
+            {
+                index = mFreeHead;
+                mFreeHead = mSlots[index].nextFree;
+                if(mFreeHead == no_slot)
+                    mFreeTail = no_slot;
+            }
+            else
+            {
+                assert(mSlots.size() < max_slots);
+                index = static_cast<std::uint32_t>(mSlots.size());
+                mSlots.emplace_back();
+            }
+
+            Slot & slot = mSlots[index];
+            slot.value = std::move(aValue);
+            slot.occupied = true;
+            ++mSize;
+            return (static_cast<key_t>(slot.generation) << index_bits) | index;
+        }
+
+        /// returns nullptr if the key is stale or has never existed
+        value_t *find(key_t aKey) noexcept
+        {
+            auto index = static_cast<std::uint32_t>(aKey & index_mask);
+            if(index >= mSlots.size())
+                return nullptr;
+            Slot & slot = mSlots[index];
+            return slot.occupied && slot.generation == (aKey >> index_bits) ?
+                &slot.value : nullptr;
+        }
+
+        /// returns false if the key is stale or has never existed
+        bool erase(key_t aKey) noexcept
+        {
+            if(!find(aKey))
+                return false;
+
+            auto index = static_cast<std::uint32_t>(aKey & index_mask);
+            Slot & slot = mSlots[index];
+            slot.value = value_t{};
+            slot.occupied = false;
+            slot.generation = (slot.generation + 1) & generation_mask;
+            if(slot.generation == 0)
+                slot.generation = 1; // keys are never 0
+            slot.nextFree = no_slot;
+            if(mFreeTail != no_slot)
+                mSlots[mFreeTail].nextFree = index;
+            else
+                mFreeHead = index;
+            mFreeTail = index;
+            --mSize;
+            return true;
+        }
+
+        std::size_t size() const noexcept
+        {
+            return mSize;
+        }
+
+    private:
+        static constexpr std::uint32_t no_slot = ~std::uint32_t{0};
+        static constexpr std::size_t max_slots = std::size_t{1} << index_bits;
+        static constexpr key_t index_mask = max_slots - 1;
+        static constexpr std::uint32_t generation_mask = static_cast<std::uint32_t>((key_t{1} << generation_bits) - 1);
+
+        struct Slot
+        {
+            value_t         value {};
+            std::uint32_t   generation { 1 };
+            std::uint32_t   nextFree { no_slot };
+            bool            occupied { false };
+        };
+
+        std::vector<Slot>   mSlots;
+        std::uint32_t       mFreeHead { no_slot }; // the free list is a queue
+        std::uint32_t       mFreeTail { no_slot };
+        std::size_t         mSize { 0 };
+    };
+
+}
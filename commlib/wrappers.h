@@ -2,6 +2,7 @@
 
 #include "commlib.h"
 #include "collector.h"
+#include "ringcollector.h"
 #include "request.h"
 #include <uv.h>
 #include <system_error>
@@ -9,6 +10,10 @@
 #include <thread>
 #include <type_traits>
 #include <memory>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <bit>
 
 namespace uvcomms4::detail
 {
@@ -106,22 +111,31 @@ namespace uvcomms4::detail
         uv_loop_t   mLoop {};
     };
 
+    /* Every callback runs inside owner_t::CallbackScope so that the owner knows when
+       control is about to return to the loop
+    */
     template<typename owner_t>
     struct cb
     {
         static void async(uv_async_t * aAsync)
         {
-            return static_cast<owner_t*>(aAsync->loop->data)->onAsync(aAsync);
+            auto owner = static_cast<owner_t*>(aAsync->loop->data);
+            typename owner_t::CallbackScope scope(owner);
+            return owner->onAsync(aAsync);
         }
 
         static void connection(uv_stream_t* aServer, int aStatus)
         {
-            return static_cast<owner_t*>(aServer->loop->data)->onConnection(aServer, aStatus);
+            auto owner = static_cast<owner_t*>(aServer->loop->data);
+            typename owner_t::CallbackScope scope(owner);
+            return owner->onConnection(aServer, aStatus);
         }
 
         static void read(uv_stream_t* aStream, ssize_t aNread, const uv_buf_t* aBuf)
         {
-            return static_cast<owner_t*>(aStream->loop->data)->onRead(aStream, aNread, aBuf);
+            auto owner = static_cast<owner_t*>(aStream->loop->data);
+            typename owner_t::CallbackScope scope(owner);
+            return owner->onRead(aStream, aNread, aBuf);
         }
 
         static void alloc(uv_handle_t* aHandle, size_t aSuggested_size, uv_buf_t* aBuf)
@@ -131,12 +145,16 @@ namespace uvcomms4::detail
 
         static void connect(uv_connect_t* aReq, int aStatus)
         {
-            return static_cast<owner_t*>(aReq->handle->loop->data)->onConnect(aReq, aStatus);
+            auto owner = static_cast<owner_t*>(aReq->handle->loop->data);
+            typename owner_t::CallbackScope scope(owner);
+            return owner->onConnect(aReq, aStatus);
         }
 
         static void write(uv_write_t* aReq, int aStatus)
         {
-            return static_cast<owner_t*>(aReq->handle->loop->data)->onWrite(aReq, aStatus);
+            auto owner = static_cast<owner_t*>(aReq->handle->loop->data);
+            typename owner_t::CallbackScope scope(owner);
+            return owner->onWrite(aReq, aStatus);
         }
 
     };
@@ -152,12 +170,20 @@ namespace uvcomms4::detail
         ~UVPipeT()
         {
             owner_t* owner = static_cast<owner_t*>(mPipe.loop->data);
-            if(mCloseRequest)
-                mCloseRequest->fulfill(0);
             if(owner)
             {
+                typename owner_t::CallbackScope scope(owner);
+                cancelWrites();
+                if(mCloseRequest)
+                    mCloseRequest->fulfill(0);
                 owner->onClosed(mDescriptor, mCloseCode);
             }
+            else
+            {
+                cancelWrites();
+                if(mCloseRequest)
+                    mCloseRequest->fulfill(0);
+            }
         }
 
         Descriptor descriptor() const { return mDescriptor; }
@@ -179,11 +205,43 @@ namespace uvcomms4::detail
             return mRecvBufferSize;
         }
 
+        /** The size for the next read buffer: the recent read sizes (see noteRead()) rounded up
+         *  to a power of two, within [aMin, aMax]; aMax until anything has been read
+        */
+        std::size_t nextReadSize(std::size_t aMin, std::size_t aMax) const noexcept
+        {
+            if(mReadSizeAverage == 0)
+                return aMax;
+            return std::clamp(std::bit_ceil(mReadSizeAverage), aMin, aMax);
+        }
+
+        /** aCount bytes have been read into a buffer of aBufferSize bytes.
+         *  The average follows a full buffer at once (there may be more waiting)
+         *  but shrinks gradually, by an eighth of the difference per read
+        */
+        void noteRead(std::size_t aCount, std::size_t aBufferSize) noexcept
+        {
+            if(aCount >= aBufferSize)
+                mReadSizeAverage = std::max(mReadSizeAverage, 2 * aBufferSize);
+            else
+            {
+                if(mReadSizeAverage == 0)
+                    mReadSizeAverage = aBufferSize;
+                mReadSizeAverage = mReadSizeAverage - mReadSizeAverage / 8 + aCount / 8;
+            }
+        }
+
         Collector& collector() noexcept
         {
             return mCollector;
         }
 
+        /// in whichever collector the pipe uses
+        std::size_t bufferedBytes() const noexcept
+        {
+            return mRing ? mRing->bufferedBytes() : mCollector.bufferedBytes();
+        }
+
         template<isUVHandleType handle_t>
         static UVPipeT* fromHandle(handle_t * aHandle) noexcept
         {
@@ -200,6 +258,12 @@ namespace uvcomms4::detail
             return uv_pipe_bind(*this, aName);
         }
 
+        /// opens an existing file descriptor (e.g. a connection accepted on another loop)
+        int open(int aFd) noexcept
+        {
+            return uv_pipe_open(*this, aFd);
+        }
+
         int listen() noexcept
         {
             mIsListener = true;
@@ -215,7 +279,20 @@ namespace uvcomms4::detail
         bfsize = std::min(bfsize, 64 * 1024);
         mRecvBufferSize = bfsize;
 #endif
-            return uv_read_start(*this, &cb<owner_t>::alloc, &cb<owner_t>::read);
+            int r = uv_read_start(*this, &cb<owner_t>::alloc, &cb<owner_t>::read);
+            mReading = (r == 0);
+            return r;
+        }
+
+        int read_stop() noexcept
+        {
+            mReading = false;
+            return uv_read_stop(*this);
+        }
+
+        bool isReading() const noexcept
+        {
+            return mReading;
         }
 
         operator uv_pipe_t * () noexcept { return &mPipe; }
@@ -237,12 +314,82 @@ namespace uvcomms4::detail
             uv_close(*this, &BaseHandle::close_cb);
         }
 
+        bool isClosing() noexcept
+        {
+            return uv_is_closing(*this);
+        }
+
+        /// fulfills the requests of the write in progress
+        void completeWrites(int aStatus)
+        {
+            for(auto & req: mWritesInFlight)
+                req->fulfill(aStatus);
+            mWritesInFlight.clear();
+        }
+
+        void cancelWrites()
+        {
+            completeWrites(UV_ECANCELED); // normally, libuv has already reported the write in progress
+            while(!mWriteQueue.empty())
+            {
+                auto req = std::move(mWriteQueue.front());
+                mWriteQueue.pop_front();
+                mQueuedBytes -= req->byteCount();
+                req->fulfill(UV_ECANCELED);
+            }
+        }
+
         uv_pipe_t   mPipe {};
         Descriptor  mDescriptor;
         bool        mIsListener { false };
         int         mRecvBufferSize { 0 };
+        std::size_t mReadSizeAverage { 0 }; // exponentially weighted; 0 until the first read
         Collector   mCollector;
+        std::unique_ptr<RingCollector> mRing; // used instead of mCollector if the owner says so
+        std::size_t mStreamRemaining { 0 }; // of the message being streamed to the delegate, if any
         std::unique_ptr<requests::CloseRequest> mCloseRequest;
+
+        // Outgoing messages are gathered into a single uv_write; only one is in progress at a time
+        std::deque<std::unique_ptr<requests::WriteRequest>>  mWriteQueue; // waiting for the next uv_write
+        std::vector<std::unique_ptr<requests::WriteRequest>> mWritesInFlight; // in the current uv_write
+        uv_write_t  mWriteRequest {};
+        bool        mWriting { false }; // mWriteRequest is in progress
+        bool        mFlushScheduled { false };
+        std::size_t mQueuedBytes { 0 }; // in mWriteQueue
+        bool        mWriteBlocked { false }; // above the high watermark; the delegate has been told
+
+        bool        mReading { false };
+        bool        mReadPaused { false }; // by pauseReading()
+        bool        mReadThrottled { false }; // by PiperOptions::readBufferLimit
+    };
+
+
+    /** A pipe that only lives long enough to accept a connection whose file descriptor
+     *  is then handed over to another loop; unlike UVPipeT, it does not report its closure to the owner
+    */
+    struct TransientPipe: BaseHandle
+    {
+        static TransientPipe* init(uv_loop_t *aLoop)
+        {
+            TransientPipe *npipe = new TransientPipe;
+            if(int r = uv_pipe_init(aLoop, &npipe->mPipe, 0); r < 0)
+            {
+                delete npipe;
+                return nullptr;
+            }
+            npipe->mPipe.data = static_cast<BaseHandle*>(npipe);
+            return npipe;
+        }
+
+        operator uv_stream_t* () noexcept { return reinterpret_cast<uv_stream_t*>(&mPipe); }
+        operator uv_handle_t* () noexcept { return reinterpret_cast<uv_handle_t*>(&mPipe); }
+
+        void close() noexcept
+        {
+            uv_close(*this, &BaseHandle::close_cb);
+        }
+
+        uv_pipe_t   mPipe {};
     };
 
 
@@ -2,6 +2,8 @@
 #include <commlib/piper.h>
 #include <commlib/commlib.h>
 #include <iostream>
+#include <thread>
+#include <algorithm>
 
 using namespace uvcomms4;
 
@@ -54,7 +56,8 @@ void echo_run()
     ensure_socket_directory_exists(cfg);
     delete_socket_file(cfg);
 
-    Piper server(std::make_shared<EchoServerDelegate>());
+    Piper server(std::make_shared<EchoServerDelegate>(),
+        PiperOptions{ .ioThreads = std::max(1u, std::thread::hardware_concurrency()) });
 
     auto [listener, errCode] = server.listen(pipe_name(cfg)).get();
 
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include "echotest.h"
+#include <commlib/bufferpool.h>
+#include <commlib/completion.h>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace uvcomms4;
+
+namespace
+{
+
+/** Keeps a view of every message so that the receive buffers outlive the server */
+class ViewKeeperDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override {}
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override {}
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override {}
+
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        auto [status, view] = aCollector.getMessageView();
+        if(status != CollectorStatus::HasMessage)
+            return;
+        std::lock_guard lk(mutex);
+        views.push_back(std::move(view));
+    }
+
+    std::size_t count()
+    {
+        std::lock_guard lk(mutex);
+        return views.size();
+    }
+
+    std::mutex               mutex;
+    std::vector<MessageView> views;
+};
+
+class SilentClientDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override {}
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override {}
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override {}
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override {}
+};
+
+}
+
+TEST(BufferPool, HitsAndMisses)
+{
+    auto pool = BufferPool::create(1, false); // rounded up to one arena
+
+    char *data = ReadBuffer::memalloc(1000, pool.get());
+    ASSERT_NE(data, nullptr);
+    std::memset(data, 'x', BufferPool::slab_size);
+    ReadBuffer::memfree(data);
+
+    char *again = ReadBuffer::memalloc(BufferPool::slab_size, pool.get());
+    EXPECT_EQ(again, data); // the free list is LIFO
+    ReadBuffer::memfree(again);
+
+    char *big = ReadBuffer::memalloc(BufferPool::slab_size + 1, pool.get()); // from the heap
+    ASSERT_NE(big, nullptr);
+    ReadBuffer::memfree(big);
+
+    BufferPoolStats stats = pool->stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 1u);
+}
+
+TEST(BufferPool, Exhausted)
+{
+    auto pool = BufferPool::create(1, false);
+
+    std::vector<char*> blocks;
+    while(char *data = pool->allocate(100))
+        blocks.push_back(data);
+    EXPECT_GT(blocks.size(), 1u);
+    EXPECT_EQ(pool->stats().misses, 1u);
+
+    char *data = ReadBuffer::memalloc(100, pool.get()); // the heap takes over
+    ASSERT_NE(data, nullptr);
+    ReadBuffer::memfree(data);
+
+    for(char *block: blocks)
+        ReadBuffer::memfree(block);
+    data = pool->allocate(100);
+    EXPECT_NE(data, nullptr);
+    ReadBuffer::memfree(data);
+}
+
+TEST(BufferPool, ReleaseFromOtherThreads)
+{
+    constexpr std::size_t rounds = 1000;
+    auto pool = BufferPool::create(64, false);
+
+    std::vector<std::thread> threads;
+    for(std::size_t r = 0; r < rounds; r++)
+    {
+        ReadBuffer buffer(ReadBuffer::memalloc(64, pool.get()), 64);
+        ASSERT_NE(buffer.data(), nullptr);
+        char *shared = buffer.share();
+        if(threads.size() == 4)
+        {
+            for(auto & t: threads)
+                t.join();
+            threads.clear();
+        }
+        threads.emplace_back([shared]{ ReadBuffer::memfree(shared); });
+    }
+    for(auto & t: threads)
+        t.join();
+
+    EXPECT_EQ(pool->stats().hits, rounds);
+    EXPECT_EQ(pool->stats().misses, 0u);
+}
+
+TEST(BufferPool, BlocksOutliveThePool)
+{
+    auto pool = BufferPool::create(1, false);
+    char *data = pool->allocate(10);
+    ASSERT_NE(data, nullptr);
+    std::memcpy(data, "0123456789", 10);
+    pool.reset(); // retired, but still holds the block
+
+    EXPECT_EQ(std::memcmp(data, "0123456789", 10), 0);
+    ReadBuffer::memfree(data); // the pool goes away here
+}
+
+TEST(BufferPool, PiperReceivesIntoPool)
+{
+    constexpr std::size_t messages_count = 50;
+
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    auto server_delegate = std::make_shared<ViewKeeperDelegate>();
+    {
+        Piper server(server_delegate, { .readBufferPoolSlabs = 16 });
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        auto [pipe, errCode] = client.connect(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(messages_count);
+        for(std::size_t i = 0; i < messages_count; i++)
+            client.write(pipe, std::string(1000 + i, 'a' + i % 26), written.callback());
+        EXPECT_EQ(written.wait(), 0);
+
+        while(server_delegate->count() < messages_count)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        EXPECT_GT(server.readBufferPoolStats().hits, 0u);
+    }
+
+    // the views keep their buffers after the server is gone
+    for(std::size_t i = 0; i < messages_count; i++)
+        EXPECT_EQ(server_delegate->views[i].copy<std::string>(), std::string(1000 + i, 'a' + i % 26));
+    server_delegate->views.clear();
+}
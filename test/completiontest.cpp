@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include "echotest.h"
+#include <commlib/completion.h>
+#include <thread>
+#include <vector>
+#include <list>
+
+using namespace uvcomms4;
+
+TEST(Completion, SetBeforeWait)
+{
+    Completion<int> done;
+    done.callback()(42);
+    EXPECT_TRUE(done.ready());
+    EXPECT_EQ(done.wait(), 42);
+}
+
+TEST(Completion, SetFromAnotherThread)
+{
+    for(int i = 0; i < 1000; i++)
+    {
+        Completion<std::tuple<Descriptor, int>> done;
+        std::thread setter([&done, i]{
+            done.set({i, 0});
+        });
+        auto [descriptor, errCode] = done.wait();
+        EXPECT_EQ(descriptor, i);
+        EXPECT_EQ(errCode, 0);
+        setter.join();
+    }
+}
+
+TEST(Completion, Batch)
+{
+    constexpr std::size_t threads_count = 8;
+    constexpr std::size_t per_thread = 1000;
+
+    Batch batch(threads_count * per_thread);
+    std::list<std::thread> threads;
+    for(std::size_t t = 0; t < threads_count; t++)
+        threads.emplace_back([&batch, t]{
+            auto cb = batch.callback();
+            for(std::size_t i = 0; i < per_thread; i++)
+            {
+                if(t == 3 && i == 10)
+                    cb(std::tuple<Descriptor, int>{0, UV_ECONNREFUSED});
+                else
+                    cb(0);
+            }
+        });
+
+    EXPECT_EQ(batch.wait(), UV_ECONNREFUSED);
+    EXPECT_TRUE(batch.ready());
+    EXPECT_EQ(batch.failures(), 1u);
+
+    for(auto & t: threads)
+        t.join();
+
+    Batch empty(0);
+    EXPECT_EQ(empty.wait(), 0);
+}
+
+namespace
+{
+
+/** Counts the echoed messages */
+class CountingClientDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override {}
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override {}
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override {}
+
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        auto [status, message] = aCollector.getMessage<std::string>();
+        if(status == CollectorStatus::HasMessage)
+            ++messages_received_count;
+    }
+
+    std::atomic<std::size_t> messages_received_count { 0 };
+};
+
+}
+
+TEST(Completion, PiperRequests)
+{
+    constexpr std::size_t messages_count = 1000;
+
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    auto server_delegate = std::make_shared<echotest::EchoServerDelegate>();
+    auto client_delegate = std::make_shared<CountingClientDelegate>();
+    {
+        Piper server(server_delegate);
+        Completion<std::tuple<Descriptor, int>> listening;
+        server.listen(pipename, listening.callback());
+        ASSERT_EQ(std::get<1>(listening.wait()), 0);
+
+        Piper client(client_delegate);
+        Completion<std::tuple<Descriptor, int>> connected;
+        client.connect(pipename, connected.callback());
+        auto [pipe, errCode] = connected.wait();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(messages_count);
+        for(std::size_t i = 0; i < messages_count; i++)
+            client.write(pipe, "message #" + std::to_string(i), written.callback());
+        EXPECT_EQ(written.wait(), 0);
+        EXPECT_EQ(written.failures(), 0u);
+
+        while(client_delegate->messages_received_count < messages_count)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        Completion<int> closed;
+        client.close(pipe, closed.callback());
+        EXPECT_EQ(closed.wait(), 0);
+    }
+
+    server_delegate->assess(1, messages_count);
+}
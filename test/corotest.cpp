@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include "echotest.h"
+#include <commlib/coro.h>
+#include <latch>
+#include <vector>
+
+using namespace uvcomms4;
+
+namespace
+{
+
+/** Hands everything incoming over to coroutines */
+class StreamingClientDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override {}
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override {}
+
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        streams.onMessage(aDescriptor, aCollector);
+    }
+
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override
+    {
+        streams.onPipeClosed(aPipe);
+        ++closed_count;
+    }
+
+    coro::MessageStreams<std::string> streams;
+    std::atomic<int> closed_count { 0 };
+};
+
+struct EchoResults
+{
+    std::atomic<int> connect_errors { 0 };
+    std::atomic<int> write_errors { 0 };
+    std::atomic<int> bad_messages { 0 };
+    std::atomic<int> good_messages { 0 };
+    std::atomic<int> ends_of_stream { 0 };
+};
+
+coro::Task echoSession(Piper & aClient, StreamingClientDelegate & aDelegate, std::string aPipeName,
+    int aMessagesCount, EchoResults & aResults, std::latch & aDone)
+{
+    auto [pipe, errCode] = co_await coro::connect(aClient, aPipeName);
+    if(errCode != 0)
+    {
+        ++aResults.connect_errors;
+        aDone.count_down();
+        co_return;
+    }
+
+    // from here on, we're on the IO thread
+    for(int i = 0; i < aMessagesCount; i++)
+    {
+        std::string message = "message #" + std::to_string(i) + std::string(i * 100, '.');
+        if(0 != co_await coro::write(aClient, pipe, std::string(message)))
+        {
+            ++aResults.write_errors;
+            break;
+        }
+
+        auto echo = co_await aDelegate.streams.next(pipe);
+        if(echo && *echo == message)
+            ++aResults.good_messages;
+        else
+            ++aResults.bad_messages;
+    }
+
+    co_await coro::close(aClient, pipe);
+    if(!co_await aDelegate.streams.next(pipe))
+        ++aResults.ends_of_stream;
+
+    aDone.count_down();
+}
+
+/** Hangs up on every incoming connection */
+class HangUpServerDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override
+    {
+        mServer = aPiper;
+    }
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override
+    {
+        mServer->close(aPipe, [](int) {});
+    }
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override {}
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override {}
+
+private:
+    Piper *mServer { nullptr };
+};
+
+coro::Task awaitEnd(StreamingClientDelegate & aDelegate, Descriptor aPipe, std::atomic<int> & aEndsOfStream, std::atomic<int> & aDone)
+{
+    if(!co_await aDelegate.streams.next(aPipe))
+        ++aEndsOfStream;
+    ++aDone;
+}
+
+}
+
+TEST(Coro, CloseWithoutMessages)
+{
+    constexpr int pipes_count = 10;
+
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    auto client_delegate = std::make_shared<StreamingClientDelegate>();
+    std::atomic<int> ends_of_stream { 0 };
+    std::atomic<int> done { 0 };
+    {
+        Piper server(std::make_shared<HangUpServerDelegate>());
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(client_delegate);
+        std::vector<Descriptor> pipes;
+        for(int i = 0; i < pipes_count; i++)
+        {
+            auto [pipe, errCode] = client.connect(pipename).get();
+            ASSERT_EQ(errCode, 0);
+            pipes.push_back(pipe);
+        }
+
+        // the peer closes them before any message or waiter has come
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while(client_delegate->closed_count < pipes_count && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ASSERT_EQ(client_delegate->closed_count, pipes_count);
+
+        for(Descriptor pipe: pipes)
+            awaitEnd(*client_delegate, pipe, ends_of_stream, done);
+
+        while(done < pipes_count && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(done, pipes_count);
+    EXPECT_EQ(ends_of_stream, pipes_count);
+}
+
+TEST(Coro, Echo)
+{
+    constexpr int sessions_count = 10;
+    constexpr int messages_count = 100;
+
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    auto server_delegate = std::make_shared<echotest::EchoServerDelegate>();
+    auto client_delegate = std::make_shared<StreamingClientDelegate>();
+    EchoResults results;
+    {
+        Piper server(server_delegate);
+        auto [listener, errCode] = server.listen(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        std::latch done(sessions_count);
+        {
+            Piper client(client_delegate);
+            for(int i = 0; i < sessions_count; i++)
+                echoSession(client, *client_delegate, pipename, messages_count, results, done);
+            done.wait();
+        }
+    }
+
+    EXPECT_EQ(results.connect_errors, 0);
+    EXPECT_EQ(results.write_errors, 0);
+    EXPECT_EQ(results.bad_messages, 0);
+    EXPECT_EQ(results.good_messages, sessions_count * messages_count);
+    EXPECT_EQ(results.ends_of_stream, sessions_count);
+    server_delegate->assess(sessions_count, messages_count);
+}
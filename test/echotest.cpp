@@ -57,32 +57,28 @@ clientWorker(std::size_t aWorkerId, std::string aPipeName, std::size_t aClientCo
  *  in either case, only the test code fails. piper works OK.
 */
 
-TEST(EchoTest, EchoTest1)
+void runEchoTest(PiperOptions const & aServerOptions, std::size_t aWorkersCount, std::size_t aClientsPerWorker,
+    std::size_t aConnectionsPerClient, std::size_t aMessagesPerConnection)
 {
     Config const &cfg = Config::get_default();
     ensure_socket_directory_exists(cfg);
     delete_socket_file(cfg);
     std::string pipename = pipe_name(cfg);
 
-    std::size_t workers_count = 25;
-    std::size_t clients_per_worker = 1;
-    std::size_t connections_per_client = 10;
-    std::size_t messages_per_connection = 1000;
-
-    auto server_delegate = std::make_shared<echotest::EchoServerDelegate>();
+    auto server_delegate = std::make_shared<echotest::EchoServerDelegate>(aServerOptions.collector != ReadCollector::List);
     {
-        Piper server(server_delegate);
+        Piper server(server_delegate, aServerOptions);
         auto [listener, errCode] = server.listen(pipename).get();
         EXPECT_EQ(errCode, 0);
 
         using worker_result = std::list<std::shared_ptr<echotest::EchoClientDelegate>>;
 
         std::list<std::future<worker_result>> wks;
-        for(std::size_t i = 0; i < workers_count; i++)
+        for(std::size_t i = 0; i < aWorkersCount; i++)
         {
             wks.emplace_back(std::async(std::launch::async, [=]{
-                return clientWorker(i, pipename, clients_per_worker,
-                    connections_per_client, messages_per_connection);
+                return clientWorker(i, pipename, aClientsPerWorker,
+                    aConnectionsPerClient, aMessagesPerConnection);
             }));
         }
 
@@ -95,36 +91,33 @@ TEST(EchoTest, EchoTest1)
             EXPECT_FALSE(result.empty());
             for(auto &delegate: result)
             {
-                delegate->assess(connections_per_client, messages_per_connection);
+                delegate->assess(aConnectionsPerClient, aMessagesPerConnection);
             }
         }
+    }
 
+    server_delegate->assess(aWorkersCount * aClientsPerWorker * aConnectionsPerClient, aMessagesPerConnection);
+}
 
-        // std::size_t client_count = 10;
-        // std::latch completionLatch(client_count);
-
-        // std::list<std::shared_ptr<echotest::EchoClientDelegate>> delegates;
-
-        // for(std::size_t i = 0; i < client_count; i++)
-        //     delegates.emplace_back(std::make_shared<echotest::EchoClientDelegate>(completionLatch));
-
-        // {
-        //     std::list<Piper> pipers;
-        //     for(auto delegate: delegates)
-        //         pipers.emplace_back(delegate);
-
-        //     for(auto delegate: delegates)
-        //         delegate->spinUp(pipename, 10, 100);
-
-        //     completionLatch.wait();
-        // }
-
-
+TEST(EchoTest, EchoTest1)
+{
+    std::size_t workers_count = 25;
+    std::size_t clients_per_worker = 1;
+    std::size_t connections_per_client = 10;
+    std::size_t messages_per_connection = 1000;
 
-        // for(auto delegate: delegates)
-        //     delegate->assess(10, 100);
-    }
+    runEchoTest({}, workers_count, clients_per_worker, connections_per_client, messages_per_connection);
+}
 
-    server_delegate->assess(workers_count * clients_per_worker * connections_per_client, messages_per_connection);
+TEST(EchoTest, EchoTestSharded)
+{
+    // the server accepts on one IO thread and hands connections over to the others
+    runEchoTest({ .ioThreads = 4 }, 5, 1, 10, 100);
+}
 
-}
\ No newline at end of file
+TEST(EchoTest, EchoTestRing)
+{
+    // the server echoes in place from the ring (see EchoServerDelegate::onRingMessage())
+    runEchoTest({ .collector = ReadCollector::Ring }, 2, 1, 4, 50);
+    runEchoTest({ .collector = ReadCollector::MirroredRing }, 2, 1, 4, 50);
+}
@@ -5,6 +5,7 @@
 #include <atomic>
 #include <deque>
 #include <map>
+#include <mutex>
 #include <string>
 #include <semaphore>
 #include <limits>
@@ -47,6 +48,11 @@ private:
 class EchoServerDelegate: public PiperDelegate
 {
 public:
+        /// aRingMessages: echo from a RingCollector in place (see PiperOptions::collector)
+        explicit EchoServerDelegate(bool aRingMessages = false):
+            mRingMessages(aRingMessages)
+        {}
+
         void Startup(Piper * aPiper) override
         {
             mServer = aPiper;
@@ -82,17 +88,38 @@ public:
             if(status == CollectorStatus::HasMessage)
             {
                 ++messages_received_count;
-                mServer->write(aDescriptor, std::move(message), [this](int r){
-                    if(r == 0)
-                        ++messages_sent_count;
-                    else {
-                        std::cerr << "SVR: WRITE ERROR: " << r << std::endl;
-                        ++write_errors_count;
-                    }
-                });
+                echo(aDescriptor, std::move(message));
             }
         }
 
+        bool takesRingMessages() const noexcept override
+        {
+            return mRingMessages;
+        }
+
+        void onRingMessage(Descriptor aDescriptor, RingCollector & aCollector) noexcept override
+        {
+            auto [status, body] = aCollector.peekMessage();
+            if(status == CollectorStatus::HasMessage)
+            {
+                ++messages_received_count;
+                echo(aDescriptor, std::string(body.begin(), body.end()));
+                aCollector.popMessage();
+            }
+        }
+
+        void echo(Descriptor aDescriptor, std::string && aMessage)
+        {
+            mServer->write(aDescriptor, std::move(aMessage), [this](int r){
+                if(r == 0)
+                    ++messages_sent_count;
+                else {
+                    std::cerr << "SVR: WRITE ERROR: " << r << std::endl;
+                    ++write_errors_count;
+                }
+            });
+        }
+
         bool    startup_called  { false };
         bool    shutdown_called { false };
         std::atomic<int> new_connection_count { 0 };
@@ -116,6 +143,7 @@ public:
 
 private:
     Piper   *mServer { nullptr };
+    bool     mRingMessages;
 };
 
 
@@ -160,7 +188,7 @@ public:
         if(aErrCode != 0)
             ++closed_with_error_count;
 
-        if(cc == pipes_created_count)
+        if(spun_up && cc == pipes_created_count)
             signalDone(); // this is not quite right - we may have extra close_count on repeated attempts to connect
     }
 
@@ -271,6 +299,11 @@ public:
             }
         }
 
+        // the connections made so far may all be closed before the next one is counted
+        spun_up = true;
+        if(close_count == pipes_created_count)
+            signalDone();
+
         if(0 == successful_connections_count)
         {
             //  there will be no onPipeClosed so we should end up early; tell the caller we're done here
@@ -300,8 +333,8 @@ public:
 
     void signalDone()
     {
-        done_signaled = true;
-        mCompletionLatch.count_down();
+        if(!done_signaled.exchange(true))
+            mCompletionLatch.count_down();
     }
 
     void assess(std::size_t aConnectionsCount, std::size_t aMessagesCount)
@@ -318,7 +351,8 @@ public:
         EXPECT_EQ(write_errors_count, 0);
     }
 
-    bool    done_signaled { false };
+    std::atomic<bool> spun_up { false }; // all connection attempts are done
+    std::atomic<bool> done_signaled { false };
     bool    startup_called { false };
     bool    shutdown_called { false };
 
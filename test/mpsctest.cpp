@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <commlib/mpsc.h>
+#include <thread>
+#include <vector>
+#include <list>
+
+namespace u = uvcomms4;
+
+namespace
+{
+    struct Item: u::MPSCNode
+    {
+        std::size_t producer { 0 };
+        std::size_t sequence { 0 };
+    };
+}
+
+TEST(MPSCQueue, SingleThread)
+{
+    u::MPSCQueue<Item> queue;
+    EXPECT_EQ(queue.pop(), nullptr);
+
+    Item items[3];
+    for(auto & item: items)
+        queue.push(&item);
+
+    EXPECT_EQ(queue.pop(), &items[0]);
+    EXPECT_EQ(queue.pop(), &items[1]);
+
+    queue.push(&items[0]);
+    EXPECT_EQ(queue.pop(), &items[2]);
+    EXPECT_EQ(queue.pop(), &items[0]);
+    EXPECT_EQ(queue.pop(), nullptr);
+}
+
+TEST(MPSCQueue, MultipleProducers)
+{
+    constexpr std::size_t producers_count = 8;
+    constexpr std::size_t items_per_producer = 20000;
+
+    std::vector<std::vector<Item>> items(producers_count);
+    for(auto & producer_items: items)
+        producer_items = std::vector<Item>(items_per_producer);
+    u::MPSCQueue<Item> queue;
+
+    std::list<std::thread> producers;
+    for(std::size_t p = 0; p < producers_count; p++)
+        producers.emplace_back([&, p]{
+            for(std::size_t i = 0; i < items_per_producer; i++)
+            {
+                items[p][i].producer = p;
+                items[p][i].sequence = i;
+                queue.push(&items[p][i]);
+            }
+        });
+
+    // every producer's items must come out in the order they were pushed
+    std::vector<std::size_t> expected(producers_count, 0);
+    std::size_t received = 0;
+    while(received < producers_count * items_per_producer)
+    {
+        if(Item *item = queue.pop())
+        {
+            EXPECT_EQ(item->sequence, expected[item->producer]);
+            expected[item->producer] = item->sequence + 1;
+            ++received;
+        }
+        else
+            std::this_thread::yield();
+    }
+
+    for(auto & producer: producers)
+        producer.join();
+
+    EXPECT_EQ(queue.pop(), nullptr);
+}
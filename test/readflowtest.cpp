@@ -0,0 +1,517 @@
+#include <gtest/gtest.h>
+
+#include "echotest.h"
+#include <commlib/completion.h>
+#include <algorithm>
+#include <future>
+
+using namespace uvcomms4;
+
+namespace
+{
+
+/** Leaves the messages in the Collector while busy */
+class BusyServerDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override {}
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override
+    {
+        pipe = aPipe;
+    }
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override {}
+
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        max_buffered = std::max(max_buffered.load(), aCollector.bufferedBytes());
+        if(busy)
+            return;
+
+        auto [status, message] = aCollector.getMessage<std::string>();
+        if(status == CollectorStatus::HasMessage)
+            ++messages_received_count;
+    }
+
+    std::atomic<bool>        busy { true };
+    std::atomic<Descriptor>  pipe { 0 };
+    std::atomic<std::size_t> max_buffered { 0 };
+    std::atomic<std::size_t> messages_received_count { 0 };
+};
+
+class SilentClientDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override {}
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override {}
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override {}
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override {}
+};
+
+}
+
+TEST(ReadFlow, LimitPausesReading)
+{
+    constexpr std::size_t messages_count = 100;
+    constexpr std::size_t message_size = 64 * 1024;
+    constexpr std::size_t read_limit = 256 * 1024;
+
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    auto server_delegate = std::make_shared<BusyServerDelegate>();
+    {
+        Piper server(server_delegate, { .readBufferLimit = read_limit });
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        auto [pipe, errCode] = client.connect(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(messages_count);
+        for(std::size_t i = 0; i < messages_count; i++)
+            client.write(pipe, std::string(message_size, 'x'), written.callback());
+
+        // the kernel buffers fill up and the rest stays with the client
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        EXPECT_FALSE(written.ready());
+        EXPECT_EQ(server_delegate->messages_received_count, 0u);
+        // the last read may overshoot the limit by one receive buffer
+        EXPECT_LE(server_delegate->max_buffered, read_limit + message_size + 64 * 1024);
+
+        server_delegate->busy = false;
+        server.resumeReading(server_delegate->pipe);
+
+        EXPECT_EQ(written.wait(), 0);
+        while(server_delegate->messages_received_count < messages_count)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST(ReadFlow, RingNeedsRingDelegate)
+{
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    // only has onMessage(), so the Ring collector asked for is not used
+    auto server_delegate = std::make_shared<BusyServerDelegate>();
+    server_delegate->busy = false;
+    {
+        Piper server(server_delegate, { .readBufferPoolSlabs = 16, .collector = ReadCollector::Ring });
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        auto [pipe, errCode] = client.connect(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        EXPECT_EQ(client.write(pipe, std::string("message")).get(), 0);
+        while(server_delegate->messages_received_count < 1)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        EXPECT_GT(server.readBufferPoolStats().hits, 0u); // only List collectors read from the pool
+    }
+}
+
+TEST(ReadFlow, PauseResume)
+{
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    auto server_delegate = std::make_shared<BusyServerDelegate>();
+    server_delegate->busy = false;
+    {
+        Piper server(server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        auto [pipe, errCode] = client.connect(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        EXPECT_EQ(client.write(pipe, std::string("first")).get(), 0);
+        while(server_delegate->messages_received_count < 1)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        server.pauseReading(server_delegate->pipe);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_EQ(client.write(pipe, std::string("second")).get(), 0); // sits in the socket buffer
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_EQ(server_delegate->messages_received_count, 1u);
+
+        server.resumeReading(server_delegate->pipe);
+        while(server_delegate->messages_received_count < 2)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+namespace
+{
+
+class LargeMessageDelegate: public SilentClientDelegate
+{
+public:
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        if(!views)
+        {
+            auto [status, message] = aCollector.getMessage<std::string>();
+            if(status != CollectorStatus::HasMessage)
+                return;
+            std::lock_guard lk(mutex);
+            messages.push_back(std::move(message));
+            return;
+        }
+
+        auto [status, view] = aCollector.getMessageView();
+        if(status != CollectorStatus::HasMessage)
+            return;
+        std::lock_guard lk(mutex);
+        segments.push_back(view.segmentCount());
+        spilled.push_back(view.spilled());
+        messages.push_back(view.copy<std::string>());
+    }
+
+    std::size_t count()
+    {
+        std::lock_guard lk(mutex);
+        return messages.size();
+    }
+
+    bool                     views { true }; // or copies
+    std::mutex               mutex;
+    std::vector<std::size_t> segments;
+    std::vector<bool>        spilled;
+    std::vector<std::string> messages;
+};
+
+}
+
+TEST(ReadFlow, LargeMessageReadDirectly)
+{
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    std::vector<std::string> sent { std::string(4 * 1024 * 1024, 'L'), "small", std::string(300 * 1024, 'M') };
+
+    auto server_delegate = std::make_shared<LargeMessageDelegate>();
+    {
+        Piper server(server_delegate, { .directReadThreshold = 128 * 1024 });
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        auto [pipe, errCode] = client.connect(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(sent.size());
+        for(auto const & message: sent)
+            client.write(pipe, std::string(message), written.callback());
+        EXPECT_EQ(written.wait(), 0);
+
+        while(server_delegate->count() < sent.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(server_delegate->messages, sent);
+    EXPECT_EQ(server_delegate->segments[0], 1u); // in a buffer of its own
+    EXPECT_EQ(server_delegate->segments[2], 1u);
+}
+
+TEST(ReadFlow, AdaptiveReadBuffers)
+{
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    // heartbeats shrink the read buffers; a larger message then arrives in many short reads
+    // which grow them back and get compacted meanwhile
+    std::vector<std::string> sent;
+    for(int i = 0; i < 50; i++)
+        sent.push_back("heartbeat " + std::to_string(i));
+    sent.push_back(std::string(200 * 1024, 'B'));
+    sent.push_back("after");
+
+    auto server_delegate = std::make_shared<LargeMessageDelegate>();
+    {
+        Piper server(server_delegate, { .compactBufferCount = 2, .directReadThreshold = 0 });
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        auto [pipe, errCode] = client.connect(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        for(std::size_t i = 0; i < sent.size(); i++)
+        {
+            std::promise<int> written;
+            client.write(pipe, std::string(sent[i]), [&written](int aErrCode){ written.set_value(aErrCode); });
+            EXPECT_EQ(written.get_future().get(), 0);
+            while(server_delegate->count() <= i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    EXPECT_EQ(server_delegate->messages, sent);
+}
+
+TEST(ReadFlow, SharedReadBuffer)
+{
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    // two pipes interleave in the shared buffer, leaving partial messages behind in their Collectors
+    std::vector<std::string> sent;
+    for(int i = 0; i < 200; i++)
+        sent.push_back(std::string(1 + i * 97 % 3000, char('a' + i % 26)));
+    sent.push_back(std::string(200 * 1024, 'S'));
+
+    std::vector<std::string> expected;
+    for(auto const & message: sent)
+        expected.insert(expected.end(), 2, message);
+    std::sort(expected.begin(), expected.end());
+
+    // copies let the buffer be reused; views make it be replaced
+    for(bool views: { false, true })
+    {
+        auto server_delegate = std::make_shared<LargeMessageDelegate>();
+        server_delegate->views = views;
+        {
+            Piper server(server_delegate, { .sharedReadBuffer = true });
+            ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+            Piper client(std::make_shared<SilentClientDelegate>());
+            auto [pipe1, err1] = client.connect(pipename).get();
+            ASSERT_EQ(err1, 0);
+            auto [pipe2, err2] = client.connect(pipename).get();
+            ASSERT_EQ(err2, 0);
+
+            Batch written(2 * sent.size());
+            for(auto const & message: sent)
+            {
+                client.write(pipe1, std::string(message), written.callback());
+                client.write(pipe2, std::string(message), written.callback());
+            }
+            EXPECT_EQ(written.wait(), 0);
+
+            while(server_delegate->count() < 2 * sent.size())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        delete_socket_file(cfg);
+
+        std::sort(server_delegate->messages.begin(), server_delegate->messages.end());
+        EXPECT_EQ(server_delegate->messages, expected);
+    }
+}
+
+namespace
+{
+
+/** Records the messages as they come, streamed or whole */
+class StreamingDelegate: public SilentClientDelegate
+{
+public:
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        auto [status, message] = aCollector.getMessage<std::string>();
+        if(status != CollectorStatus::HasMessage)
+            return;
+        std::lock_guard lk(mutex);
+        messages.push_back(std::move(message));
+        streamed.push_back(false);
+    }
+
+    void onMessageBegin(Descriptor aDescriptor, std::size_t aLength) noexcept override
+    {
+        current.clear();
+        expected_length = aLength;
+        chunks = 0;
+    }
+
+    void onMessageChunk(Descriptor aDescriptor, std::span<const char> aChunk) noexcept override
+    {
+        current.append(aChunk.begin(), aChunk.end());
+        ++chunks;
+    }
+
+    void onMessageEnd(Descriptor aDescriptor) noexcept override
+    {
+        EXPECT_EQ(current.size(), expected_length);
+        max_chunks = std::max(max_chunks, chunks);
+        std::lock_guard lk(mutex);
+        messages.push_back(std::move(current));
+        streamed.push_back(true);
+    }
+
+    std::size_t count()
+    {
+        std::lock_guard lk(mutex);
+        return messages.size();
+    }
+
+    std::mutex               mutex;
+    std::vector<std::string> messages;
+    std::vector<bool>        streamed;
+
+    std::string              current; // IO thread only
+    std::size_t              expected_length { 0 };
+    std::size_t              chunks { 0 };
+    std::size_t              max_chunks { 0 };
+};
+
+}
+
+TEST(ReadFlow, StreamingLargeMessages)
+{
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    constexpr std::size_t threshold = 64 * 1024;
+    std::vector<std::string> sent { "first", std::string(4 * 1024 * 1024, 'S'), "between",
+        std::string(threshold, 'T'), std::string(threshold - 1, 'U'), "last" };
+
+    auto server_delegate = std::make_shared<StreamingDelegate>();
+    {
+        Piper server(server_delegate, { .streamingThreshold = threshold });
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        auto [pipe, errCode] = client.connect(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(sent.size());
+        for(auto const & message: sent)
+            client.write(pipe, std::string(message), written.callback());
+        EXPECT_EQ(written.wait(), 0);
+
+        while(server_delegate->count() < sent.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(server_delegate->messages, sent);
+    EXPECT_EQ(server_delegate->streamed, (std::vector<bool>{ false, true, false, true, false, false }));
+    EXPECT_GT(server_delegate->max_chunks, 1u); // the large one came as it was read
+}
+
+TEST(ReadFlow, SpillLargeMessages)
+{
+    static_assert(requests::MessageableContainer<MessageView>);
+
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    std::vector<std::string> sent { std::string(3 * 1024 * 1024 + 5, 'P'), "small", std::string(1024 * 1024, 'Q') };
+
+    auto server_delegate = std::make_shared<LargeMessageDelegate>();
+    {
+        // no direct reads otherwise: only the spilled messages get a buffer of their own
+        Piper server(server_delegate, { .directReadThreshold = 0, .spillThreshold = 1024 * 1024 });
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        auto [pipe, errCode] = client.connect(pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(sent.size());
+        for(auto const & message: sent)
+            client.write(pipe, std::string(message), written.callback());
+        EXPECT_EQ(written.wait(), 0);
+
+        while(server_delegate->count() < sent.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(server_delegate->messages, sent);
+    EXPECT_EQ(server_delegate->spilled, (std::vector<bool>{ true, false, true }));
+    EXPECT_EQ(server_delegate->segments[0], 1u);
+    EXPECT_EQ(server_delegate->segments[2], 1u);
+}
+
+namespace
+{
+
+/** Decodes the messages into memory from Piper::messageResource() */
+class ArenaDelegate: public SilentClientDelegate
+{
+public:
+    void Startup(Piper * aPiper) override
+    {
+        piper = aPiper;
+    }
+
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        std::pmr::memory_resource *resource = piper->messageResource(aDescriptor);
+        auto [status, message] = aCollector.getMessage<std::pmr::string>(resource);
+        if(status != CollectorStatus::HasMessage)
+            return;
+        std::lock_guard lk(mutex);
+        from_resource = from_resource && message.get_allocator().resource() == resource;
+        messages.emplace_back(message.begin(), message.end());
+    }
+
+    std::size_t count()
+    {
+        std::lock_guard lk(mutex);
+        return messages.size();
+    }
+
+    Piper                   *piper { nullptr };
+    std::mutex               mutex;
+    bool                     from_resource { true };
+    std::vector<std::string> messages;
+};
+
+}
+
+TEST(ReadFlow, MessageResource)
+{
+    Config const &cfg = Config::get_default();
+    ensure_socket_directory_exists(cfg);
+    delete_socket_file(cfg);
+    std::string pipename = pipe_name(cfg);
+
+    // more than the initial arena in a single read callback
+    std::vector<std::string> sent;
+    for(int i = 0; i < 100; i++)
+        sent.push_back(std::string(100 + i * 1000, char('a' + i % 26)));
+
+    auto server_delegate = std::make_shared<ArenaDelegate>();
+    {
+        Piper server(server_delegate, { .ioThreads = 2 });
+        ASSERT_EQ(std::get<1>(server.listen(pipename).get()), 0);
+
+        Piper client(std::make_shared<SilentClientDelegate>());
+        Batch written(2 * sent.size());
+        for(int c = 0; c < 2; c++) // to both IO threads
+        {
+            auto [pipe, errCode] = client.connect(pipename).get();
+            ASSERT_EQ(errCode, 0);
+            for(auto const & message: sent)
+                client.write(pipe, std::string(message), written.callback());
+        }
+        EXPECT_EQ(written.wait(), 0);
+
+        while(server_delegate->count() < 2 * sent.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_TRUE(server_delegate->from_resource);
+    std::vector<std::string> expected;
+    for(auto const & message: sent)
+        expected.insert(expected.end(), 2, message);
+    std::sort(expected.begin(), expected.end());
+    std::sort(server_delegate->messages.begin(), server_delegate->messages.end());
+    EXPECT_EQ(server_delegate->messages, expected);
+}
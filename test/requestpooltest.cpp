@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <commlib/request.h>
+#include <thread>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <cstring>
+
+namespace r = uvcomms4::requests;
+
+TEST(RequestPool, Recycle)
+{
+    r::RequestPool pool;
+
+    void *p1 = r::RequestPool::allocate(&pool, 100);
+    void *p2 = r::RequestPool::allocate(&pool, 100);
+    EXPECT_NE(p1, p2);
+    r::RequestPool::deallocate(p1);
+    EXPECT_EQ(r::RequestPool::allocate(&pool, 100), p1); // most recently freed first
+    r::RequestPool::deallocate(p1);
+    r::RequestPool::deallocate(p2);
+
+    // too big for any size class: heap
+    void *big = r::RequestPool::allocate(&pool, 100000);
+    EXPECT_NE(big, nullptr);
+    r::RequestPool::deallocate(big);
+
+    void *heap = r::RequestPool::allocate(nullptr, 100);
+    r::RequestPool::deallocate(heap);
+}
+
+TEST(RequestPool, Requests)
+{
+    r::RequestPool pool;
+    int result = 0;
+
+    auto req = r::makeCloseRequest(pool, 1, [&](int aResult) { result = aResult; });
+    req->abort();
+    EXPECT_EQ(result, UV_ECANCELED);
+    void *address = req.get();
+    req.reset();
+
+    // the block is reused by the next request of the same size class
+    auto req2 = r::makeCloseRequest(pool, 2, [&](int aResult) { result = aResult; });
+    EXPECT_EQ(static_cast<void*>(req2.get()), address);
+}
+
+TEST(RequestPool, AllocateOnManyThreadsReleaseOnOne)
+{
+    constexpr std::size_t producers_count = 8;
+    constexpr std::size_t allocations = 20000;
+
+    r::RequestPool pool;
+    std::mutex mx;
+    std::vector<void*> allocated;
+
+    std::list<std::thread> producers;
+    for(std::size_t p = 0; p < producers_count; p++)
+        producers.emplace_back([&]{
+            for(std::size_t i = 0; i < allocations; i++)
+            {
+                void *ptr = r::RequestPool::allocate(&pool, 32 + i % 400);
+                std::memset(ptr, 0xAB, 32);
+                std::lock_guard lk(mx);
+                allocated.push_back(ptr);
+            }
+        });
+
+    std::size_t released = 0;
+    while(released < producers_count * allocations)
+    {
+        std::vector<void*> batch;
+        {
+            std::lock_guard lk(mx);
+            batch.swap(allocated);
+        }
+        for(void *ptr: batch)
+            r::RequestPool::deallocate(ptr);
+        released += batch.size();
+        std::this_thread::yield();
+    }
+
+    for(auto & producer: producers)
+        producer.join();
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include "messagemock.h"
+#include <commlib/ringcollector.h>
+#include <cstring>
+#include <string>
+
+namespace mm = messagemock;
+namespace u = uvcomms4;
+
+namespace
+{
+    /// writes aCount bytes of aStream starting at aPos the way a read would
+    void feed(u::RingCollector &aCollector, mm::stream_t const &aStream, std::size_t &aPos, std::size_t aCount)
+    {
+        while(aCount > 0)
+        {
+            auto space = aCollector.writable();
+            ASSERT_FALSE(space.empty());
+            std::size_t n = std::min(aCount, space.size());
+            std::memcpy(space.data(), &aStream[aPos], n);
+            aCollector.commit(n);
+            aPos += n;
+            aCount -= n;
+        }
+    }
+
+    void runSequence(bool aMirrored)
+    {
+        mm::stream_t stream;
+        std::vector<std::string> messages;
+        for(std::size_t i = 0; i < 200; i++)
+        {
+            messages.emplace_back(i * 997 % 40000, char('a' + i % 26));
+            mm::appendMessage(stream, messages.back());
+        }
+
+        u::RingCollector collector(aMirrored);
+        std::size_t fed = 0;
+        std::size_t received = 0;
+        for(std::size_t chunk = 1; fed < stream.size(); chunk = chunk * 3 % 50021)
+        {
+            feed(collector, stream, fed, std::min(chunk, stream.size() - fed));
+            while(true)
+            {
+                auto [st, body] = collector.peekMessage();
+                ASSERT_NE(st, u::CollectorStatus::Corrupt);
+                if(st != u::CollectorStatus::HasMessage)
+                    break;
+                ASSERT_EQ(std::string_view(body.data(), body.size()), messages[received]);
+                collector.popMessage();
+                received++;
+            }
+        }
+        EXPECT_EQ(received, messages.size());
+        EXPECT_EQ(collector.bufferedBytes(), 0u);
+        EXPECT_LE(collector.capacity(), 128u * 1024);
+    }
+}
+
+TEST(RingCollector, InPlace)
+{
+    runSequence(false);
+}
+
+TEST(RingCollector, Mirrored)
+{
+    runSequence(true);
+}
+
+TEST(RingCollector, GetMessage)
+{
+    mm::stream_t stream;
+    std::string msg1 = "Message1234";
+    std::string msg2 = "";
+    std::string msg3(300000, 'z'); // has to grow
+    mm::appendMessage(stream, msg1);
+    mm::appendMessage(stream, msg2);
+    mm::appendMessage(stream, msg3);
+
+    u::RingCollector collector;
+    std::size_t fed = 0;
+    feed(collector, stream, fed, 4);
+    EXPECT_EQ(collector.status(), u::CollectorStatus::NoMessage);
+    feed(collector, stream, fed, stream.size() - fed);
+    EXPECT_GE(collector.capacity(), stream.size());
+
+    auto [st1, m1] = collector.getMessage<std::string>();
+    EXPECT_EQ(st1, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(m1, msg1);
+    auto [st2, m2] = collector.getMessage<std::string>();
+    EXPECT_EQ(st2, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(m2, msg2);
+    auto [st3, m3] = collector.getMessage<std::vector<char>>();
+    EXPECT_EQ(st3, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(std::string(m3.begin(), m3.end()), msg3);
+    EXPECT_EQ(collector.status(), u::CollectorStatus::NoMessage);
+}
+
+TEST(RingCollector, Corrupt)
+{
+    mm::stream_t stream;
+    mm::appendMessage(stream, "Message");
+    stream[5] ^= 1;
+
+    u::RingCollector collector;
+    std::size_t fed = 0;
+    feed(collector, stream, fed, stream.size());
+    EXPECT_EQ(collector.status(), u::CollectorStatus::Corrupt);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <commlib/slotmap.h>
+#include <vector>
+
+namespace u = uvcomms4;
+
+TEST(SlotMap, InsertFindErase)
+{
+    u::SlotMap<int> slots;
+    auto k1 = slots.insert(1);
+    auto k2 = slots.insert(2);
+    EXPECT_NE(k1, 0);
+    EXPECT_NE(k1, k2);
+    EXPECT_EQ(slots.size(), 2);
+
+    ASSERT_NE(slots.find(k1), nullptr);
+    EXPECT_EQ(*slots.find(k1), 1);
+    EXPECT_EQ(*slots.find(k2), 2);
+
+    EXPECT_TRUE(slots.erase(k1));
+    EXPECT_FALSE(slots.erase(k1));
+    EXPECT_EQ(slots.find(k1), nullptr);
+    EXPECT_EQ(slots.size(), 1);
+
+    EXPECT_EQ(slots.find(k2 + 1), nullptr); // never existed
+    EXPECT_EQ(slots.find(0), nullptr);
+}
+
+TEST(SlotMap, StaleKeys)
+{
+    u::SlotMap<int> slots;
+    auto k1 = slots.insert(1);
+    slots.erase(k1);
+
+    // the slot is reused but the old key must not match the new occupant
+    auto k2 = slots.insert(2);
+    constexpr auto index_mask = (u::SlotMap<int>::key_t{1} << u::SlotMap<int>::index_bits) - 1;
+    EXPECT_EQ(k1 & index_mask, k2 & index_mask);
+    EXPECT_NE(k1, k2);
+    EXPECT_EQ(slots.find(k1), nullptr);
+    ASSERT_NE(slots.find(k2), nullptr);
+    EXPECT_EQ(*slots.find(k2), 2);
+}
+
+TEST(SlotMap, Churn)
+{
+    u::SlotMap<std::size_t> slots;
+    std::vector<u::SlotMap<std::size_t>::key_t> keys;
+
+    for(std::size_t round = 0; round < 10; round++)
+    {
+        for(std::size_t i = 0; i < 1000; i++)
+            keys.push_back(slots.insert(i));
+        for(auto key: keys)
+        {
+            EXPECT_LE(key, u::SlotMap<std::size_t>::key_mask);
+            EXPECT_TRUE(slots.erase(key));
+        }
+        keys.clear();
+    }
+
+    EXPECT_EQ(slots.size(), 0);
+}
+
+TEST(SlotMap, ReuseGoesRound)
+{
+    u::SlotMap<int> slots;
+    constexpr auto index_mask = (u::SlotMap<int>::key_t{1} << u::SlotMap<int>::index_bits) - 1;
+
+    std::vector<u::SlotMap<int>::key_t> keys;
+    for(int i = 0; i < 4; i++)
+        keys.push_back(slots.insert(i));
+    for(auto key: keys)
+        slots.erase(key);
+
+    // connect/close churn on a single key takes the free slots in turn rather than the same one
+    for(int i = 0; i < 8; i++)
+    {
+        auto key = slots.insert(i);
+        EXPECT_EQ(key & index_mask, keys[i % 4] & index_mask);
+        EXPECT_TRUE(slots.erase(key));
+    }
+    EXPECT_EQ(slots.size(), 0);
+}
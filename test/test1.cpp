@@ -5,6 +5,13 @@
 #include <commlib/collector.h>
 #include <cstring>
 #include <string>
+#include <string_view>
+#include <memory_resource>
+#include <vector>
+#include <cstdlib>
+#ifdef __linux__
+#include <sys/statvfs.h>
+#endif
 
 namespace mm = messagemock;
 namespace u = uvcomms4;
@@ -222,4 +229,336 @@ TEST(MessageFormat, Collector_GetMessage)
     EXPECT_EQ(msg3, emsg3);
     EXPECT_EQ(msg4, emsg4);
 
-}
\ No newline at end of file
+}
+
+namespace
+{
+    u::ReadBuffer makeReadBuffer(char const *aData, std::size_t aSize)
+    {
+        char *block = u::ReadBuffer::memalloc(aSize);
+        std::memcpy(block, aData, aSize);
+        return u::ReadBuffer(block, aSize);
+    }
+}
+
+TEST(MessageFormat, Collector_GetMessageView)
+{
+    mm::stream_t stream;
+    std::string msg1 = "Message1234";      // 0: [8 bytes header]  8: [11 bytes message]
+    std::string msg2 = "SomeOtherMessage"; //19: [8 bytes header] 27: [16 bytes message]
+    std::string msg3 = "";                 //43: [8 bytes header]
+    std::string msg4 = "OneMoreMessage";   //51: [8 bytes header] 59: [14 bytes message] (up to 73)
+
+    mm::appendMessage(stream, msg1);
+    mm::appendMessage(stream, msg2);
+    mm::appendMessage(stream, msg3);
+    mm::appendMessage(stream, msg4);
+
+    // buffer 0: [0-30) msg1 entirely, buffer boundary in msg2's body
+    // buffer 1: [30-62) buffer boundary in msg4's body
+    // buffer 2: [62-73)
+    u::MessageView view1, view2, view3, view4;
+    {
+        u::Collector collector;
+        collector.append(makeReadBuffer(&stream[0], 30));
+        collector.append(makeReadBuffer(&stream[30], 32));
+        collector.append(makeReadBuffer(&stream[62], 11));
+
+        u::CollectorStatus st;
+        std::tie(st, view1) = collector.getMessageView();
+        EXPECT_EQ(st, u::CollectorStatus::HasMessage);
+        std::tie(st, view2) = collector.getMessageView();
+        EXPECT_EQ(st, u::CollectorStatus::HasMessage);
+        std::tie(st, view3) = collector.getMessageView();
+        EXPECT_EQ(st, u::CollectorStatus::HasMessage);
+        std::tie(st, view4) = collector.getMessageView();
+        EXPECT_EQ(st, u::CollectorStatus::HasMessage);
+        std::tie(st, std::ignore) = collector.getMessageView();
+        EXPECT_EQ(st, u::CollectorStatus::NoMessage);
+    } // the views outlive the collector
+
+    EXPECT_TRUE(view1.contiguous());
+    EXPECT_EQ(std::string_view(view1.span().data(), view1.span().size()), msg1);
+
+    EXPECT_FALSE(view2.contiguous());
+    EXPECT_EQ(view2.segmentCount(), 2u);
+    EXPECT_EQ(view2.size(), msg2.size());
+    EXPECT_EQ(view2.copy<std::string>(), msg2);
+
+    EXPECT_TRUE(view3.contiguous());
+    EXPECT_EQ(view3.size(), 0u);
+
+    EXPECT_EQ(view4.segmentCount(), 2u);
+    u::MessageView shared = view4;
+    view4 = {};
+    EXPECT_EQ(shared.copy<std::string>(), msg4);
+}
+
+TEST(MessageFormat, MessageView_ManySegments)
+{
+    mm::stream_t stream;
+    std::string msg = "A message split into many tiny buffers";
+    mm::appendMessage(stream, msg);
+
+    u::Collector collector;
+    for(std::size_t i = 0; i < stream.size(); i += 3)
+        collector.append(makeReadBuffer(&stream[i], std::min<std::size_t>(3, stream.size() - i)));
+
+    auto [st, view] = collector.getMessageView();
+    EXPECT_EQ(st, u::CollectorStatus::HasMessage);
+    EXPECT_GT(view.segmentCount(), u::MessageView::inline_segments);
+    EXPECT_EQ(view.copy<std::string>(), msg);
+
+    u::MessageView moved(std::move(view));
+    EXPECT_EQ(view.segmentCount(), 0u);
+    EXPECT_EQ(moved.copy<std::vector<char>>(), std::vector<char>(msg.begin(), msg.end()));
+}
+
+TEST(MessageFormat, Collector_ByteByByte)
+{
+    mm::stream_t stream;
+    std::string msg1 = "First message";
+    std::string msg2 = "Second";
+    mm::appendMessage(stream, msg1);
+    mm::appendMessage(stream, msg2);
+
+    u::Collector collector;
+    std::size_t fed = 0;
+    auto feed = [&](std::size_t aCount) {
+        for(; aCount > 0; aCount--, fed++)
+            collector.append(makeReadBuffer(&stream[fed], 1));
+    };
+
+    std::size_t first_size = u::Collector::header_size + msg1.size();
+    feed(first_size - 1);
+    EXPECT_EQ(collector.status(), u::CollectorStatus::NoMessage);
+    EXPECT_EQ(collector.messageLength(), (std::ptrdiff_t)msg1.size());
+    EXPECT_EQ(collector.bufferedBytes(), first_size - 1);
+
+    feed(3); // the first message and a part of the second header
+    EXPECT_EQ(collector.status(), u::CollectorStatus::HasMessage);
+    auto [st1, m1] = collector.getMessage<std::string>();
+    EXPECT_EQ(st1, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(m1, msg1);
+    EXPECT_EQ(collector.bufferedBytes(), 2u);
+    EXPECT_EQ(collector.messageLength(), u::MORE_DATA);
+
+    feed(stream.size() - fed);
+    auto [st2, m2] = collector.getMessage<std::string>();
+    EXPECT_EQ(st2, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(m2, msg2);
+    EXPECT_EQ(collector.bufferedBytes(), 0u);
+    EXPECT_EQ(collector.status(), u::CollectorStatus::NoMessage);
+}
+
+TEST(MessageFormat, Collector_ReserveMessage)
+{
+    mm::stream_t stream;
+    std::string msg1(100000, 'q');
+    std::string msg2 = "Next";
+    mm::appendMessage(stream, msg1);
+    mm::appendMessage(stream, msg2);
+
+    u::Collector collector;
+    EXPECT_EQ(collector.expectedRemaining(), 0u);
+    EXPECT_TRUE(collector.reserveMessage().empty());
+
+    collector.append(makeReadBuffer(&stream[0], 5));
+    EXPECT_EQ(collector.expectedRemaining(), 0u); // no header yet
+    collector.append(makeReadBuffer(&stream[5], 995));
+    std::size_t frame = u::Collector::header_size + msg1.size();
+    EXPECT_EQ(collector.expectedRemaining(), frame - 1000);
+
+    EXPECT_TRUE(collector.reserveMessage(frame).empty()); // not that much missing
+    auto space = collector.reserveMessage();
+    ASSERT_EQ(space.size(), frame - 1000);
+    EXPECT_TRUE(collector.isReserved(space.data()));
+    EXPECT_EQ(collector.bufferedBytes(), 1000u);
+
+    std::memcpy(space.data(), &stream[1000], 50000);
+    collector.commit(50000);
+    EXPECT_EQ(collector.status(), u::CollectorStatus::NoMessage);
+
+    space = collector.reserveMessage(frame); // already reserved: the rest of it
+    ASSERT_EQ(space.size(), frame - 51000);
+    std::memcpy(space.data(), &stream[51000], space.size());
+    collector.commit(space.size());
+    EXPECT_FALSE(collector.isReserved(space.data()));
+    EXPECT_EQ(collector.expectedRemaining(), 0u);
+
+    collector.append(makeReadBuffer(&stream[frame], stream.size() - frame));
+    auto [st1, view] = collector.getMessageView();
+    EXPECT_EQ(st1, u::CollectorStatus::HasMessage);
+    EXPECT_TRUE(view.contiguous());
+    EXPECT_EQ(view.copy<std::string>(), msg1);
+
+    auto [st2, m2] = collector.getMessage<std::string>();
+    EXPECT_EQ(st2, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(m2, msg2);
+}
+
+TEST(MessageFormat, Collector_Compact)
+{
+    mm::stream_t stream;
+    std::string msg1 = "Some message";
+    std::string msg2(300, 'c');
+    mm::appendMessage(stream, msg1);
+    mm::appendMessage(stream, msg2);
+
+    u::Collector collector;
+    std::size_t pos = 0;
+    for(; pos + 10 < stream.size(); pos += 10)
+        collector.append(makeReadBuffer(&stream[pos], 10));
+    std::size_t buffered = collector.bufferedBytes();
+
+    // the first message is taken and msg2 is partially read
+    auto [st1, m1] = collector.getMessage<std::string>();
+    EXPECT_EQ(st1, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(m1, msg1);
+    EXPECT_EQ(collector.messageLength(), std::ptrdiff_t(msg2.size()));
+    EXPECT_GT(collector.bufferCount(), 2u);
+
+    EXPECT_TRUE(collector.compact());
+    EXPECT_EQ(collector.bufferCount(), 1u);
+    EXPECT_EQ(collector.bufferedBytes(), buffered - msg1.size() - u::Collector::header_size);
+    EXPECT_EQ(collector.messageLength(), std::ptrdiff_t(msg2.size()));
+
+    collector.append(makeReadBuffer(&stream[pos], stream.size() - pos));
+    auto [st2, m2] = collector.getMessage<std::string>();
+    EXPECT_EQ(st2, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(m2, msg2);
+    EXPECT_EQ(collector.bufferCount(), 0u);
+}
+
+TEST(MessageFormat, Collector_Consume)
+{
+    mm::stream_t stream;
+    std::string msg1(100, 'x');
+    std::string msg2 = "Tail";
+    mm::appendMessage(stream, msg1);
+    mm::appendMessage(stream, msg2);
+
+    u::Collector collector;
+    collector.append(makeReadBuffer(&stream[0], 50));
+    collector.append(makeReadBuffer(&stream[50], stream.size() - 50));
+    ASSERT_EQ(collector.messageLength(true), std::ptrdiff_t(msg1.size()));
+
+    std::string body;
+    std::size_t chunks = 0;
+    auto sink = [&](std::span<const char> aChunk) {
+        body.append(aChunk.begin(), aChunk.end());
+        ++chunks;
+    };
+    EXPECT_EQ(collector.consume(30, sink), 30u);
+    EXPECT_EQ(collector.consume(msg1.size() - 30, sink), msg1.size() - 30);
+    EXPECT_EQ(body, msg1);
+    EXPECT_EQ(chunks, 3u); // 30 bytes, then the rest of the first buffer and the start of the second
+
+    auto [st, m2] = collector.getMessage<std::string>();
+    EXPECT_EQ(st, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(m2, msg2);
+    EXPECT_EQ(collector.consume(10, sink), 0u);
+}
+
+TEST(MessageFormat, Collector_Spill)
+{
+    mm::stream_t stream;
+    std::string msg(70000, 's');
+    mm::appendMessage(stream, msg);
+
+    u::Collector collector;
+    collector.append(makeReadBuffer(&stream[0], 1000));
+    EXPECT_TRUE(collector.reserveMessage(1000000, 100000).empty()); // neither long nor missing enough
+    auto space = collector.reserveMessage(1000000, msg.size());
+    ASSERT_EQ(space.size(), stream.size() - 1000);
+    std::memcpy(space.data(), &stream[1000], space.size());
+    collector.commit(space.size());
+
+    auto [st, view] = collector.getMessageView();
+    EXPECT_EQ(st, u::CollectorStatus::HasMessage);
+    EXPECT_TRUE(view.spilled());
+    ASSERT_TRUE(view.contiguous());
+    EXPECT_EQ(std::string(view.begin(), view.end()), msg);
+}
+
+#ifdef __linux__
+TEST(MessageFormat, SpillNeedsRoom)
+{
+    // a tmpfs, so that a spill file bigger than the whole file system cannot be created sparse
+    struct statvfs fs {};
+    if(statvfs("/dev/shm", &fs) != 0 || fs.f_blocks == 0)
+        GTEST_SKIP() << "no /dev/shm";
+    std::size_t too_big = fs.f_blocks * fs.f_frsize + 1024 * 1024 * 1024;
+
+    char const *tmpdir = getenv("TMPDIR");
+    std::string saved = tmpdir ? tmpdir : "";
+    setenv("TMPDIR", "/dev/shm", 1);
+    void *block = u::map_spill(too_big);
+    if(tmpdir)
+        setenv("TMPDIR", saved.c_str(), 1);
+    else
+        unsetenv("TMPDIR");
+
+    EXPECT_EQ(block, nullptr);
+    u::unmap_spill(block, too_big);
+
+    block = u::map_spill(1024 * 1024);
+    ASSERT_NE(block, nullptr);
+    std::memset(block, 'x', 1024 * 1024);
+    u::unmap_spill(block, 1024 * 1024);
+}
+#endif
+
+TEST(MessageFormat, Collector_Allocator)
+{
+    mm::stream_t stream;
+    std::string msg(1000, 'a');
+    mm::appendMessage(stream, msg);
+    mm::appendMessage(stream, msg);
+
+    u::Collector collector;
+    collector.append(makeReadBuffer(&stream[0], 500));
+    collector.append(makeReadBuffer(&stream[500], stream.size() - 500));
+
+    // nowhere else to allocate from
+    std::byte arena[4096];
+    std::pmr::monotonic_buffer_resource resource(arena, sizeof(arena), std::pmr::null_memory_resource());
+    auto [st, m1] = collector.getMessage<std::pmr::string>(&resource);
+    EXPECT_EQ(st, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(std::string_view(m1), msg);
+    EXPECT_EQ(m1.get_allocator().resource(), &resource);
+
+    auto [st2, m2] = collector.getMessage<std::pmr::vector<char>>(&resource);
+    EXPECT_EQ(st2, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(std::string(m2.begin(), m2.end()), msg);
+
+    auto [st3, m3] = collector.getMessage<std::pmr::string>(&resource);
+    EXPECT_EQ(st3, u::CollectorStatus::NoMessage);
+    EXPECT_TRUE(m3.empty());
+}
+
+TEST(MessageFormat, Collector_BulkCopy)
+{
+    mm::stream_t stream;
+    std::string msg(u::nontemporal_copy_threshold + 12345, '\0');
+    for(std::size_t i = 0; i < msg.size(); i++)
+        msg[i] = char(i * 7 % 251);
+    mm::appendMessage(stream, msg);
+    mm::appendMessage(stream, "tail");
+
+    u::Collector collector;
+    for(std::size_t i = 0; i < stream.size(); i += 65521)
+        collector.append(makeReadBuffer(&stream[i], std::min<std::size_t>(65521, stream.size() - i)));
+
+    std::vector<unsigned char> partial;
+    EXPECT_FALSE(collector.copyTo(partial, stream.size() + 1, true)); // takes what there is, stays put
+    EXPECT_EQ(partial.size(), stream.size());
+    EXPECT_EQ(collector.bufferedBytes(), stream.size());
+
+    auto [st1, m1] = collector.getMessage<std::string>();
+    EXPECT_EQ(st1, u::CollectorStatus::HasMessage);
+    EXPECT_TRUE(m1 == msg);
+    auto [st2, m2] = collector.getMessage<std::vector<char>>();
+    EXPECT_EQ(st2, u::CollectorStatus::HasMessage);
+    EXPECT_EQ(std::string(m2.begin(), m2.end()), "tail");
+}
@@ -0,0 +1,494 @@
+#include <gtest/gtest.h>
+
+#include "echotest.h"
+#include <commlib/completion.h>
+#include <vector>
+#include <array>
+#include <span>
+#include <tuple>
+#include <algorithm>
+#include <ranges>
+
+using namespace uvcomms4;
+
+namespace
+{
+
+/** Collects the echoed messages (IO thread) */
+class RecordingClientDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override {}
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override {}
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override {}
+
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        auto [status, message] = aCollector.getMessage<std::string>();
+        if(status == CollectorStatus::HasMessage)
+        {
+            std::lock_guard lk(mx);
+            messages.push_back(std::move(message));
+        }
+    }
+
+    std::size_t received()
+    {
+        std::lock_guard lk(mx);
+        return messages.size();
+    }
+
+    std::mutex mx;
+    std::vector<std::string> messages;
+};
+
+struct EchoFixture
+{
+    EchoFixture()
+    {
+        configure_signals(); // the server may write to a pipe that the client has already closed
+        Config const &cfg = Config::get_default();
+        ensure_socket_directory_exists(cfg);
+        delete_socket_file(cfg);
+        pipename = pipe_name(cfg);
+    }
+
+    std::string pipename;
+    std::shared_ptr<echotest::EchoServerDelegate> server_delegate { std::make_shared<echotest::EchoServerDelegate>() };
+    std::shared_ptr<RecordingClientDelegate> client_delegate { std::make_shared<RecordingClientDelegate>() };
+};
+
+}
+
+TEST(WriteQueue, BurstKeepsOrder)
+{
+    constexpr std::size_t messages_count = 5000;
+
+    EchoFixture f;
+    std::vector<std::size_t> completions; // IO thread, then read after the batch is done
+    {
+        Piper server(f.server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate);
+        auto [pipe, errCode] = client.connect(f.pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(messages_count);
+        for(std::size_t i = 0; i < messages_count; i++)
+            client.write(pipe, std::to_string(i), [&, i, cb = written.callback()](int aErrCode) {
+                completions.push_back(i);
+                cb(aErrCode);
+            });
+        EXPECT_EQ(written.wait(), 0);
+
+        while(f.client_delegate->received() < messages_count)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        EXPECT_EQ(client.close(pipe).get(), 0);
+    }
+
+    ASSERT_EQ(completions.size(), messages_count);
+    ASSERT_EQ(f.client_delegate->messages.size(), messages_count);
+    for(std::size_t i = 0; i < messages_count; i++)
+    {
+        EXPECT_EQ(completions[i], i);
+        EXPECT_EQ(f.client_delegate->messages[i], std::to_string(i));
+    }
+    f.server_delegate->assess(1, messages_count);
+}
+
+TEST(WriteQueue, CloseCancelsQueuedWrites)
+{
+    constexpr std::size_t messages_count = 200;
+
+    EchoFixture f;
+    std::atomic<std::size_t> succeeded { 0 };
+    std::atomic<std::size_t> cancelled { 0 };
+    {
+        Piper server(f.server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate);
+        auto [pipe, errCode] = client.connect(f.pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(messages_count);
+        for(std::size_t i = 0; i < messages_count; i++)
+            client.write(pipe, std::string(256 * 1024, 'x'), [&, cb = written.callback()](int aErrCode) {
+                if(aErrCode == 0)
+                    ++succeeded;
+                else if(aErrCode == UV_ECANCELED)
+                    ++cancelled;
+                cb(aErrCode);
+            });
+        EXPECT_EQ(client.close(pipe).get(), 0);
+        written.wait(); // every request has been fulfilled one way or the other
+    }
+
+    EXPECT_EQ(succeeded + cancelled, messages_count);
+}
+
+TEST(WriteQueue, CloseSendsQueuedWrites)
+{
+    constexpr int pipes_count = 10;
+
+    EchoFixture f;
+    {
+        Piper server(f.server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate);
+        for(int i = 0; i < pipes_count; i++)
+        {
+            auto [pipe, errCode] = client.connect(f.pipename).get();
+            ASSERT_EQ(errCode, 0);
+
+            // both are likely to be dispatched together, before the write has been flushed
+            std::promise<int> written;
+            client.write(pipe, std::string("last words"), [&written](int aErrCode) { written.set_value(aErrCode); });
+            auto closed = client.close(pipe);
+            EXPECT_EQ(written.get_future().get(), 0);
+            EXPECT_EQ(closed.get(), 0);
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while(f.server_delegate->messages_received_count < pipes_count && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(f.server_delegate->messages_received_count, pipes_count);
+}
+
+namespace
+{
+
+/** Reads slowly; mutes the server's own output */
+class SlowSinkDelegate: public PiperDelegate
+{
+public:
+    void Startup(Piper * aPiper) override {}
+    void Shutdown() noexcept override {}
+    void onNewConnection(Descriptor aListener, Descriptor aPipe) noexcept override {}
+    void onPipeClosed(Descriptor aPipe, int aErrCode) noexcept override {}
+
+    void onMessage(Descriptor aDescriptor, Collector & aCollector) noexcept override
+    {
+        auto [status, message] = aCollector.getMessage<std::string>();
+        if(status == CollectorStatus::HasMessage)
+        {
+            ++messages_received_count;
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    }
+
+    std::atomic<std::size_t> messages_received_count { 0 };
+};
+
+/** Records the backpressure notifications */
+class ThrottledClientDelegate: public RecordingClientDelegate
+{
+public:
+    void onWriteBlocked(Descriptor aPipe) noexcept override
+    {
+        ++blocked_count;
+        writable = false;
+    }
+
+    void onWritable(Descriptor aPipe) noexcept override
+    {
+        ++writable_count;
+        writable = true;
+        writable.notify_all();
+    }
+
+    std::atomic<int>  blocked_count { 0 };
+    std::atomic<int>  writable_count { 0 };
+    std::atomic<bool> writable { true };
+};
+
+}
+
+TEST(WriteQueue, Watermarks)
+{
+    constexpr std::size_t messages_count = 200;
+    constexpr std::size_t message_size = 64 * 1024;
+
+    EchoFixture f;
+    auto server_delegate = std::make_shared<SlowSinkDelegate>();
+    auto client_delegate = std::make_shared<ThrottledClientDelegate>();
+    {
+        Piper server(server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(client_delegate, { .writeHighWatermark = 1024 * 1024, .writeLowWatermark = 256 * 1024 });
+        auto [pipe, errCode] = client.connect(f.pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        // the producer stops whenever it's told to
+        Batch written(messages_count);
+        for(std::size_t i = 0; i < messages_count; i++)
+        {
+            client_delegate->writable.wait(false);
+            client.write(pipe, std::string(message_size, 'x'), written.callback());
+        }
+        EXPECT_EQ(written.wait(), 0);
+
+        while(server_delegate->messages_received_count < messages_count)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_GT(client_delegate->blocked_count, 0);
+    EXPECT_EQ(client_delegate->blocked_count, client_delegate->writable_count);
+}
+
+TEST(WriteQueue, FailAboveHighWatermark)
+{
+    constexpr std::size_t messages_count = 200;
+    constexpr std::size_t message_size = 64 * 1024;
+
+    EchoFixture f;
+    auto server_delegate = std::make_shared<SlowSinkDelegate>();
+    std::atomic<std::size_t> succeeded { 0 };
+    std::atomic<std::size_t> rejected { 0 };
+    {
+        Piper server(server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate, { .writeHighWatermark = 1024 * 1024, .failWritesAboveHighWatermark = true });
+        auto [pipe, errCode] = client.connect(f.pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(messages_count);
+        for(std::size_t i = 0; i < messages_count; i++)
+            client.write(pipe, std::string(message_size, 'x'), [&, cb = written.callback()](int aErrCode) {
+                if(aErrCode == 0)
+                    ++succeeded;
+                else if(aErrCode == UV_EAGAIN)
+                    ++rejected;
+                cb(aErrCode);
+            });
+        written.wait();
+
+        while(server_delegate->messages_received_count < succeeded)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_GT(rejected, 0u);
+    EXPECT_GT(succeeded, 0u);
+    EXPECT_EQ(succeeded + rejected, messages_count);
+}
+
+TEST(WriteQueue, MultipartMessages)
+{
+    constexpr std::size_t messages_count = 500;
+
+    EchoFixture f;
+    std::string borrowed(100000, 'b'); // outlives the writes
+    std::vector<std::string> expected;
+    {
+        Piper server(f.server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate);
+        auto [pipe, errCode] = client.connect(f.pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        Batch written(messages_count + 1);
+        for(std::size_t i = 0; i < messages_count; i++)
+        {
+            std::array<char, 4> head { 'H', char('0' + i % 10), ':', ' ' };
+            std::string meta = std::to_string(i);
+            std::vector<char> payload(i * 100, char('a' + i % 26));
+            std::string empty;
+
+            expected.push_back(std::string(head.begin(), head.end()) + meta + std::string(payload.begin(), payload.end()));
+            client.write(pipe, std::tuple(head, std::move(meta), std::move(empty), std::move(payload)), written.callback());
+        }
+        expected.push_back("borrowed " + borrowed);
+        client.write(pipe, std::tuple(std::string("borrowed "), std::span<const char>(borrowed)), written.callback());
+        EXPECT_EQ(written.wait(), 0);
+
+        while(f.client_delegate->received() < expected.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        EXPECT_EQ(client.close(pipe).get(), 0);
+    }
+
+    EXPECT_EQ(f.client_delegate->messages, expected);
+}
+
+TEST(WriteQueue, WriteMany)
+{
+    constexpr std::size_t batch_size = 1000; // more messages than fit in one writev()
+
+    EchoFixture f;
+    std::vector<std::string> expected;
+    {
+        Piper server(f.server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate);
+        auto [pipe, errCode] = client.connect(f.pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        std::vector<std::string> batch;
+        for(std::size_t i = 0; i < batch_size; i++)
+            batch.push_back("message " + std::to_string(i) + std::string(i % 50, char('a' + i % 26)));
+        batch.push_back(""); // an empty message is still framed
+        expected.insert(expected.end(), batch.begin(), batch.end());
+        auto first = client.writeMany(pipe, std::move(batch));
+
+        EXPECT_EQ(client.writeMany(pipe, std::vector<std::string>()).get(), 0);
+
+        std::vector<std::vector<char>> large(3, std::vector<char>(300000, 'x'));
+        for(auto const & message: large)
+            expected.emplace_back(message.begin(), message.end());
+        std::promise<int> done;
+        client.writeMany(pipe, std::move(large), [&done](int aStatus) { done.set_value(aStatus); });
+
+        EXPECT_EQ(first.get(), 0);
+        EXPECT_EQ(done.get_future().get(), 0);
+
+        while(f.client_delegate->received() < expected.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        EXPECT_EQ(client.close(pipe).get(), 0);
+    }
+
+    EXPECT_EQ(f.client_delegate->messages, expected);
+}
+
+TEST(WriteQueue, WriteManyViews)
+{
+    static_assert(requests::detail::keeps_messages<std::vector<std::string>>);
+    static_assert(!requests::detail::keeps_messages<std::ranges::ref_view<std::vector<std::string>>>);
+
+    EchoFixture f;
+    std::vector<std::string> expected;
+    {
+        Piper server(f.server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate);
+        auto [pipe, errCode] = client.connect(f.pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        // every message is a temporary made on the fly
+        auto made = std::views::iota(0, 300) | std::views::transform([](int i) {
+            return "made " + std::to_string(i) + std::string(100, char('a' + i % 26));
+        });
+        for(auto && message: made)
+            expected.push_back(message);
+        auto first = client.writeMany(pipe, made);
+
+        std::future<int> second;
+        {
+            std::vector<std::string> borrowed { "borrowed", std::string(100000, 'b') };
+            expected.insert(expected.end(), borrowed.begin(), borrowed.end());
+            second = client.writeMany(pipe, std::views::all(borrowed));
+            std::fill(borrowed.begin(), borrowed.end(), std::string("gone"));
+        }
+
+        EXPECT_EQ(first.get(), 0);
+        EXPECT_EQ(second.get(), 0);
+
+        while(f.client_delegate->received() < expected.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        EXPECT_EQ(client.close(pipe).get(), 0);
+    }
+
+    EXPECT_EQ(f.client_delegate->messages, expected);
+}
+
+TEST(WriteQueue, Fanout)
+{
+    constexpr std::size_t pipes_count = 8;
+
+    EchoFixture f;
+    SharedPayload payload(std::string(200000, 'p'));
+    EXPECT_EQ(payload.useCount(), 1);
+    std::vector<std::string> expected;
+    {
+        Piper server(f.server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate, { .ioThreads = 2 }); // the pipes are spread over both IO threads
+        std::vector<Descriptor> pipes;
+        for(std::size_t i = 0; i < pipes_count; i++)
+        {
+            auto [pipe, errCode] = client.connect(f.pipename).get();
+            ASSERT_EQ(errCode, 0);
+            pipes.push_back(pipe);
+        }
+
+        EXPECT_EQ(client.writeFanout(pipes, payload).get(), 0);
+        EXPECT_EQ(payload.useCount(), 1); // the pipes have let go of it
+        EXPECT_EQ(client.writeFanout({}, payload).get(), 0);
+        while(f.client_delegate->received() < pipes_count)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        std::vector<Descriptor> some_gone { pipes[0], pipes[1] };
+        EXPECT_EQ(client.close(pipes[1]).get(), 0);
+        std::promise<int> done;
+        client.writeFanout(some_gone, SharedPayload(std::string("last")), [&done](int aStatus) { done.set_value(aStatus); });
+        EXPECT_EQ(done.get_future().get(), UV_ENOTCONN);
+
+        expected.assign(pipes_count, std::string(payload.begin(), payload.end()));
+        expected.push_back("last");
+        while(f.client_delegate->received() < expected.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        for(std::size_t i = 0; i < pipes_count; i++)
+        {
+            if(i != 1)
+            {
+                EXPECT_EQ(client.close(pipes[i]).get(), 0);
+            }
+        }
+    }
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(f.client_delegate->messages.begin(), f.client_delegate->messages.end());
+    EXPECT_EQ(f.client_delegate->messages, expected);
+}
+
+TEST(WriteQueue, BorrowedWrites)
+{
+    static constexpr char table[] = "a static table";
+
+    EchoFixture f;
+    std::vector<char> region(1024 * 1024);
+    for(std::size_t i = 0; i < region.size(); i++)
+        region[i] = char('a' + i % 26);
+    std::vector<std::string> expected;
+    {
+        Piper server(f.server_delegate);
+        ASSERT_EQ(std::get<1>(server.listen(f.pipename).get()), 0);
+
+        Piper client(f.client_delegate);
+        auto [pipe, errCode] = client.connect(f.pipename).get();
+        ASSERT_EQ(errCode, 0);
+
+        std::span<const char> tableSpan(table, sizeof(table) - 1);
+        expected.emplace_back(tableSpan.begin(), tableSpan.end());
+        auto first = client.writeBorrowed(pipe, tableSpan);
+
+        expected.emplace_back(region.begin(), region.end());
+        std::promise<int> done;
+        client.writeBorrowed(pipe, region, [&done](int aStatus) { done.set_value(aStatus); });
+
+        EXPECT_EQ(first.get(), 0);
+        EXPECT_EQ(done.get_future().get(), 0);
+        std::fill(region.begin(), region.end(), 'x'); // the write is done with it
+
+        while(f.client_delegate->received() < expected.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        EXPECT_EQ(client.close(pipe).get(), 0);
+    }
+
+    EXPECT_EQ(f.client_delegate->messages, expected);
+}